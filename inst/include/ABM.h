@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AggregatePopulation.h"
 #include "Network.h"
 #include "RNG.h"
 #include "Simulation.h"
@@ -3,10 +3,12 @@
 #include "Event.h"
 #include "State.h"
 #include <map>
+#include <vector>
 
 class Simulation;
 class Population;
 class ContactTransition;
+class ContactEvent;
 
 /**
  * The class is an abstraction of an agent. The key task of an agent is to
@@ -37,6 +39,13 @@ public:
    */
   Agent(Rcpp::Nullable<Rcpp::List> state = R_NilValue);
 
+  /**
+   * Constructor that creates an agent that takes a given state as is
+   *
+   * @param state the initial state, which is not copied
+   */
+  Agent(const State &state);
+
   virtual ~Agent();
 
   /**
@@ -87,7 +96,7 @@ public:
   /** 
    * Access the state of the agent
    */
-  Rcpp::List state() const { return _state; }
+  const State &state() const { return _state.get(); }
 
   /**
    * Reports the state to the population the agent is in.
@@ -121,9 +130,33 @@ public:
    */
   const PXPLease &membershipLease();
 
+  /**
+   * The generation of the population membership, which changes whenever
+   * the agent leaves its population. Unlike a lease, it allocates nothing,
+   * so that C++ code can check that a membership is current cheaply.
+   */
+  unsigned int membership() const { return _membership; }
+
   /** Lazily create a token that expires when this agent is destroyed. */
   const PXPLease &lifetimeLease() const;
 
+  /**
+   * A handle of this agent that is valid for a callback scope. The handle
+   * is created on first use and reused for later scopes.
+   */
+  SEXP borrow(const XPScope &scope);
+
+  /**
+   * The calendar of the contact events of the agent, which is created and
+   * scheduled on first use
+   */
+  Calendar &contactEvents();
+
+  /**
+   * Unschedule all contact events, and release the contact calendar
+   */
+  void clearContactEvents();
+
   /** the simulation that it is in */
   virtual Simulation *simulation();
   /** the simulation that it is in */
@@ -187,10 +220,35 @@ protected:
   /** Optional lifetime token for uncommon long-lived observers. */
   mutable std::unique_ptr<PXPLease> _lifetime_lease;
 
+  /** The handle passed to the callbacks, created on first use. */
+  std::unique_ptr<XPHandle<Agent> > _handle;
+
 private:
   friend class Simulation; // so that Simulation can call attached
   friend class Population;
   friend class ContactTransition;
+  friend class ContactCalendar;
+  friend class AggregatePopulation;
+  friend class ContactEvent;
+
+  /**
+   * Release the contact calendar if it is empty
+   */
+  void releaseContactEvents();
+
+  /**
+   * Cancel the pending contact events of other agents whose contact is this
+   * agent, which leaves its population, as their handlers would discard them
+   */
+  void cancelDependents();
+
+  /**
+   * Notify the observers that the agent is leaving its population, as if
+   * its state became empty
+   *
+   * @return the state of the agent, to be restored after it has left
+   */
+  State vacate();
   /**
    * The agent id, which is unique in the simulation. 
    * 
@@ -204,11 +262,24 @@ private:
    */
   IndexType _index;
   /**
-   * The state of the agent
+   * The generation of the population membership
+   */
+  unsigned int _membership;
+  /**
+   * The state of the agent, shared with the agents in the same state
    */
-  State _state;
+  SharedState _state;
   /**
-   * A calendar holding all the transition events 
+   * A calendar holding all the contact events, or nullptr if the agent has
+   * none
    */
   PCalendar _contactEvents;
+  /**
+   * The pending contact events of other agents whose contact is this agent,
+   * which become stale if this agent leaves its population
+   */
+  std::vector<ContactEvent*> _dependents;
 };
+
+template<>
+struct XPExactTag<Agent> : std::true_type {};
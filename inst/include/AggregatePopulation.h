@@ -0,0 +1,264 @@
+#pragma once
+
+#include "Population.h"
+#include "RNG.h"
+#include "Transition.h"
+#include <vector>
+
+class Simulation;
+
+/**
+ * A binary tree of non-negative weights, each internal node holding the sum
+ * of its children, used to select an element with a probability
+ * proportional to its weight in logarithmic time.
+ */
+class SumTree {
+public:
+  SumTree();
+
+  /** the number of weights */
+  size_t size() const { return _size; }
+
+  /** append a weight */
+  void push_back(double weight);
+
+  /** change the weight of element i */
+  void set(size_t i, double weight);
+
+  /** the weight of element i */
+  double get(size_t i) const { return _tree[_capacity + i]; }
+
+  /** the sum of all weights */
+  double total() const { return _tree[1]; }
+
+  /**
+   * The element whose cumulative weight range contains u
+   *
+   * @param u a number between 0 and total()
+   */
+  size_t find(double u) const;
+
+  /** remove all weights */
+  void clear();
+
+private:
+  size_t _size;
+  size_t _capacity;
+  std::vector<double> _tree;
+};
+
+/**
+ * A well-mixed population that is simulated at the level of compartments,
+ * i.e., the number of individuals in each state, instead of one agent per
+ * individual.
+ *
+ * The transitions of the simulation that apply to the states in this
+ * population, and the contact transitions of its random mixing contact
+ * pattern, are simulated with the Gillespie direct method. Each pair of a
+ * rule and a compartment (or, for a contact transition, a pair of
+ * compartments) is a reaction channel, whose propensity is kept in a sum
+ * tree. A reaction only updates the propensities of the channels that
+ * involve the compartments it changes.
+ *
+ * The rules must have exponentially distributed waiting times and no
+ * callbacks, so that the count level dynamics is exact. The state changes
+ * are reported to the loggers of the simulation, and the event loggers of
+ * the rules are invoked, as if the individuals were agents. Individuals can
+ * be converted into agents with materialize().
+ *
+ * Optionally, the reactions are simulated approximately by tau-leaping,
+ * i.e., the number of times each channel fires in a leap of length tau is
+ * drawn from a Poisson distribution, and the firings are applied in bulk.
+ * The leap size is selected so that the propensities are not expected to
+ * change by more than a fraction epsilon (Cao, Gillespie and Petzold 2006).
+ * When a leap would not be much longer than the next exact reaction, or
+ * the firings would make a count negative, the exact method is used.
+ */
+class AggregatePopulation : public Population {
+public:
+  /**
+   * Constructor
+   *
+   * @param states the states of the compartments
+   *
+   * @param counts the number of individuals in each compartment
+   *
+   * @param contact the random mixing contact pattern, or nullptr if the
+   * individuals have no contacts
+   */
+  AggregatePopulation(Rcpp::List states, Rcpp::NumericVector counts,
+                      PContact contact = nullptr);
+
+  virtual ~AggregatePopulation();
+
+  /**
+   * Compile the reaction channels from the rules of the simulation, report
+   * the individuals to the loggers, and schedule the first reaction.
+   */
+  virtual void report() override;
+
+  /**
+   * Fire the next reaction and schedule the following one
+   *
+   * @param sim the simulation object
+   *
+   * @param time the time of the reaction
+   */
+  void react(Simulation &sim, double time);
+
+  /**
+   * The states of the compartments and their counts, as a list
+   */
+  Rcpp::List compartments() const;
+
+  /**
+   * Convert individuals into agents
+   *
+   * @param rule the state that the individuals must match
+   *
+   * @param k the number of individuals, sampled uniformly among those that
+   * match the rule
+   *
+   * @return the new agents, which are not in any population
+   *
+   * @details The individuals leave this population, and the next reaction
+   * is rescheduled.
+   */
+  std::vector<PAgent> materialize(const Rcpp::List &rule, size_t k);
+
+  /**
+   * Set the error control parameter of tau-leaping
+   *
+   * @param epsilon the bound of the relative change of the propensities in
+   * a leap, or 0 to simulate the reactions exactly
+   */
+  void setTauLeaping(double epsilon);
+
+  static Rcpp::CharacterVector classes;
+
+private:
+  /**
+   * the individuals in the same state
+   */
+  struct Compartment {
+    State state;
+    double count;
+    /** the channels whose propensities depend on the count */
+    std::vector<size_t> channels;
+  };
+
+  /**
+   * A transition rule of the simulation, as applied to the compartments
+   */
+  struct Rule {
+    Transition *transition;
+    ContactTransition *contact;
+    /** the contact pattern of a contact transition */
+    Contact *source;
+    /** the rate of the exponential waiting time */
+    double rate;
+    /** whether the rule has been checked to be aggregatable */
+    bool checked;
+    /** the destination compartments of the agent and the contact, by the
+     * source compartment, or NONE if not yet known */
+    std::vector<size_t> to, contact_to;
+    /** the event passed to the event loggers of the rule, reused by all
+     * its reactions like the agents standing for the individuals */
+    PEvent event;
+  };
+
+  /**
+   * A reaction, i.e., a rule applied to an individual in a compartment,
+   * and for a contact transition, its contact in another compartment
+   */
+  struct Channel {
+    size_t rule;
+    size_t from;
+    size_t contact;
+  };
+
+  /**
+   * The net changes of the counts of the compartments by one firing of a
+   * channel
+   */
+  struct Stoichiometry {
+    size_t size;
+    size_t compartment[4];
+    double change[4];
+    /** whether the channel consumes two individuals */
+    bool second_order;
+  };
+
+  static const size_t NONE;
+
+  /** find the compartment of a state, adding it if it does not exist */
+  size_t compartment(const State &state);
+
+  /** the compartment that an individual in compartment c moves to */
+  size_t destination(std::vector<size_t> &cache, size_t c,
+                     const Rcpp::List &to);
+
+  /** add the channels that involve a new compartment */
+  void addChannels(size_t c);
+
+  /** add a channel and its propensity */
+  void addChannel(size_t rule, size_t from, size_t contact);
+
+  /** make sure that a rule can be aggregated, and find its rate */
+  void check(Rule &rule);
+
+  /** the propensity of a channel, checking its rule once the propensity
+   * can be positive */
+  double propensity(const Channel &channel);
+
+  /** update the propensities of the channels that involve compartment c */
+  void update(size_t c);
+
+  /** update the propensities of the contact channels, when the total
+   * number of individuals changes */
+  void updateContacts();
+
+  /** the compartments that the agent and the contact of a channel move to */
+  void destinations(const Channel &channel, size_t &to, size_t &contact_to);
+
+  /** the net changes of the counts by one firing of a channel */
+  Stoichiometry stoichiometry(const Channel &channel);
+
+  /**
+   * Select a leap and draw the number of firings of each channel
+   *
+   * @return the leap size, or 0 if the next reaction should be exact
+   */
+  double leap();
+
+  /** fire a channel k times */
+  void fire(Simulation &sim, const Channel &channel, double k);
+
+  /** move k individuals between compartments */
+  void move(size_t from, size_t to, double k);
+
+  /** report a state change of count individuals to the simulation */
+  void log(Simulation &sim, Agent &proxy, size_t from, size_t to,
+           double count);
+
+  /** replace the next reaction by one drawn at the given time */
+  void reschedule(double time);
+
+  std::vector<Compartment> _compartments;
+  std::vector<Rule> _rules;
+  std::vector<Channel> _channels;
+  /** the indices of the contact channels */
+  std::vector<size_t> _contact_channels;
+  SumTree _propensities;
+  double _individuals;
+  PEvent _next;
+  /** the error control parameter of tau-leaping, 0 if exact */
+  double _epsilon;
+  /** the channels that fire at the end of the leap, and the numbers of
+   * firings, empty if the next reaction is exact */
+  std::vector<std::pair<size_t, double> > _firings;
+  /** agents standing for the individuals whose states change in a reaction,
+   * passed to the loggers */
+  PAgent _agent, _contact;
+  RUnif _unif;
+};
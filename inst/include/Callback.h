@@ -0,0 +1,281 @@
+#pragma once
+
+#include "RNG.h"
+#include "XP.h"
+#include <Rcpp.h>
+#include <string>
+#include <vector>
+
+class Agent;
+
+/**
+ * The signature of a native transition callback.
+ *
+ * @param time the current simulation time
+ *
+ * @param agent the agent that the transition applies to. For a contact
+ * transition, this is the agent who initiates the contact.
+ *
+ * @param contact the contacted agent for a contact transition, or nullptr
+ * for a spontaneous transition
+ *
+ * @param data the data pointer given when the callback was created, or
+ * nullptr
+ *
+ * @return for a to_change callback, whether the transition should happen.
+ * The return value of a changed callback is ignored.
+ *
+ * @details A native callback is called directly from C++, without creating
+ * R objects for its arguments. It may read and set the state of the agents,
+ * but must not keep references to them after it returns.
+ */
+typedef bool (*NativeCallbackFunction)(
+    double time, Agent &agent, Agent *contact, void *data);
+
+/**
+ * Cast a function pointer to another function pointer type, e.g., to and
+ * from DL_FUNC, the type of the functions registered with R.
+ *
+ * @details The cast goes through void (*)(void), which compilers accept as
+ * a generic function pointer, so that -Wcast-function-type does not warn.
+ * The result must be cast back to the original type before it is called.
+ */
+template<class To, class From>
+inline To castFunction(From f)
+{
+  return reinterpret_cast<To>(reinterpret_cast<void (*)(void)>(f));
+}
+
+/**
+ * Wrap a native callback function in an external pointer, so that it can
+ * be passed to newNativeCallback() from R.
+ *
+ * @details This is intended for code compiled against the ABM headers,
+ * e.g., a function exported by Rcpp::sourceCpp() with
+ * `// [[Rcpp::depends(ABM)]]`.
+ */
+inline SEXP makeNativeCallbackPointer(NativeCallbackFunction f)
+{
+  return R_MakeExternalPtrFn(
+    castFunction<DL_FUNC>(f), Rf_install("NativeCallbackFunction"),
+    R_NilValue);
+}
+
+/**
+ * Match the state of an agent from native code compiled against the ABM
+ * headers, but not linked to the ABM package.
+ *
+ * @param rule an R list of the domains and their values to match
+ *
+ * @details The function is registered with R_RegisterCCallable when the
+ * package is loaded. Agent::state() can be used directly to read a state.
+ * The R objects are passed as SEXP, so that the Rcpp classes of the
+ * calling code need not match those of the package.
+ */
+inline bool matchAgentState(const Agent &agent, SEXP rule)
+{
+  typedef bool (*Function)(const Agent &, SEXP);
+  static Function f = castFunction<Function>(
+    R_GetCCallable("ABM", "matchAgentState"));
+  return f(agent, rule);
+}
+
+/**
+ * Merge values into the state of an agent from native code compiled against
+ * the ABM headers, notifying the loggers and transition rules.
+ *
+ * @param state an R list of the domains and their new values
+ */
+inline void setAgentState(Agent &agent, SEXP state)
+{
+  typedef void (*Function)(Agent &, SEXP);
+  static Function f = castFunction<Function>(
+    R_GetCCallable("ABM", "setAgentState"));
+  f(agent, state);
+}
+
+/**
+ * A callback invoked by a transition rule before (to_change) or after
+ * (changed) a state transition.
+ */
+class Callback : public RefCountedObject {
+public:
+  typedef RefCountedObject PointerBase;
+  static constexpr std::uint32_t TAG = XP_CALLBACK;
+
+  virtual ~Callback();
+
+  /**
+   * Invoke the callback before a state transition
+   *
+   * @param time the current simulation time
+   *
+   * @param agent the agent that the transition applies to
+   *
+   * @param contact the contacted agent, or nullptr for a spontaneous
+   * transition
+   *
+   * @return true if the transition should happen
+   */
+  virtual bool toChange(double time, Agent &agent, Agent *contact) = 0;
+
+  /**
+   * Invoke the callback after a state transition
+   *
+   * @details the default implementation calls toChange() and ignores its
+   * result.
+   */
+  virtual void changed(double time, Agent &agent, Agent *contact);
+
+  static Rcpp::CharacterVector classes;
+};
+
+typedef OwnedPointer<Callback> PCallback;
+
+/**
+ * A callback implemented by an R function
+ *
+ * @details The R function takes the time and an external pointer to the
+ * agent, and, for a contact transition, an external pointer to the contact.
+ * The external pointers expire when the function returns.
+ */
+class RCallback : public Callback {
+public:
+  RCallback(Rcpp::Function f);
+
+  virtual bool toChange(double time, Agent &agent, Agent *contact);
+  virtual void changed(double time, Agent &agent, Agent *contact);
+
+protected:
+  SEXP call(double time, Agent &agent, Agent *contact);
+
+  Rcpp::Function _f;
+};
+
+/**
+ * A callback implemented by a native function
+ */
+class NativeCallback : public Callback {
+public:
+  /**
+   * Constructor
+   *
+   * @param f the native function
+   *
+   * @param data an R object passed to f as the address of an external
+   * pointer, or R_NilValue to pass nullptr. The object is kept alive as long
+   * as the callback.
+   */
+  NativeCallback(NativeCallbackFunction f, SEXP data = R_NilValue);
+
+  virtual bool toChange(double time, Agent &agent, Agent *contact);
+
+protected:
+  NativeCallbackFunction _f;
+  Rcpp::RObject _data;
+  void *_address;
+};
+
+/**
+ * A to_change callback that lets a transition happen with a given
+ * probability
+ */
+class ProbabilityCallback : public Callback {
+public:
+  ProbabilityCallback(double p);
+
+  virtual bool toChange(double time, Agent &agent, Agent *contact);
+
+protected:
+  double _p;
+  RUnif _unif;
+};
+
+/**
+ * A changed callback that records the transition time in a state domain
+ * of the agent
+ *
+ * @details As a to_change callback, it always lets the transition happen,
+ * and records nothing.
+ */
+class TimestampCallback : public Callback {
+public:
+  TimestampCallback(const std::string &name);
+
+  virtual bool toChange(double time, Agent &agent, Agent *contact);
+  virtual void changed(double time, Agent &agent, Agent *contact);
+
+protected:
+  /** the update of the domain, whose name is interned once */
+  Rcpp::List _update;
+};
+
+/**
+ * A to_change callback implemented by a vectorized R function that is
+ * called once for the events of a transition rule that happen within a
+ * time window
+ *
+ * @details The R function takes a numeric vector of event times, a list
+ * of agents and, for a contact transition, a list of contacts, and returns
+ * a logical vector with one element for each event. The agents are either
+ * external pointers that expire when the function returns, or their states.
+ *
+ * A transition rule with a batch callback defers its events, and applies
+ * the accepted transitions at the end of the window, i.e., at most window
+ * time units after the events.
+ */
+class BatchCallback : public Callback {
+public:
+  /**
+   * Constructor
+   *
+   * @param f the R function
+   *
+   * @param window the length of the time window, a positive number
+   *
+   * @param states whether to pass the states of the agents instead of
+   * external pointers to them
+   */
+  BatchCallback(Rcpp::Function f, double window, bool states = false);
+
+  /** the length of the time window */
+  double window() const { return _window; }
+
+  /**
+   * Evaluate a batch of events
+   *
+   * @param time the times of the events
+   *
+   * @param agents the agents that the transitions apply to
+   *
+   * @param contacts the contacted agents, or an empty vector for a
+   * spontaneous transition
+   *
+   * @return whether each transition should happen
+   */
+  std::vector<bool> evaluate(const std::vector<double> &time,
+                             const std::vector<Agent*> &agents,
+                             const std::vector<Agent*> &contacts);
+
+  virtual bool toChange(double time, Agent &agent, Agent *contact);
+
+protected:
+  Rcpp::List arguments(const std::vector<Agent*> &agents,
+                       const XPScope &scope) const;
+
+  Rcpp::Function _f;
+  double _window;
+  bool _states;
+};
+
+/**
+ * Convert an R value to a callback
+ *
+ * @param value NULL, an R function, or an external pointer to a Callback
+ * object
+ *
+ * @param argument the argument name used in validation errors
+ *
+ * @return the callback, or nullptr if value is NULL
+ */
+PCallback parseCallback(SEXP value, const std::string &argument);
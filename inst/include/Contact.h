@@ -60,6 +60,11 @@ public:
    */
   bool hasRate() const { return static_cast<bool>(_waiting_time); }
 
+  /**
+   * The waiting-time generator of the contact events, or nullptr
+   */
+  const PWaitingTime &rate() const { return _waiting_time; }
+
   /**
    * Assign a legacy transition-level rate during registration.
    */
@@ -98,6 +103,18 @@ public:
    */
   virtual void add(Agent &agent) = 0;
 
+  /**
+   * Add a batch of agents to the contact pattern
+   *
+   * @param agents the agents that will be added to the contact pattern
+   *
+   * @details This is called when agents are added to a population in bulk,
+   * after all of them have joined the population. The default implementation
+   * adds the agents one by one. A contact pattern may override this method to
+   * grow its internal structures once for the whole batch.
+   */
+  virtual void add(const std::vector<Agent*> &agents);
+
   /** 
    * Finalize the contact pattern
    * 
@@ -177,6 +194,8 @@ public:
   virtual const std::vector<Agent*> &contact(double time, Agent &agent);
   
   virtual void add(Agent &agent);
+
+  virtual void add(const std::vector<Agent*> &agents);
   
   virtual void build();
   
@@ -228,6 +247,8 @@ public:
   virtual const std::vector<Agent*> &contact(double time, Agent &agent);
   
   virtual void add(Agent &agent);
+
+  using Contact::add;
   
   virtual void build();
   
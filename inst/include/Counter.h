@@ -2,6 +2,7 @@
 
 #include "Agent.h"
 #include <string>
+#include <vector>
 
 /**
  * An abstract class that represents logging state changes of agents.
@@ -38,6 +39,21 @@ public:
    */
   virtual void log(const Agent &agent, const State &from_state) = 0;
 
+  /**
+   * Logs the same state change of several agents, e.g., the individuals of
+   * an aggregated population
+   *
+   * @param agent an agent in the state after the change
+   *
+   * @param from_state the original state of the agents
+   *
+   * @param count the number of agents
+   *
+   * @details The default logs the change count times. The loggers of the
+   * package override it to log the changes at once.
+   */
+  virtual void log(const Agent &agent, const State &from_state, double count);
+
   /**
    * Select this logger before a state change. The default implementation
    * selects no logger; legacy counters override it.
@@ -49,10 +65,78 @@ public:
    */
   virtual void stateChanged(const Agent &agent);
 
+  /**
+   * The state domains that this logger watches
+   *
+   * @param domains the names of the domains, CHARSXPs held by the logger,
+   * are appended to it
+   *
+   * @return true if stateChanging() can only select this logger when a
+   * state change sets one of the domains, so that the simulation needs to
+   * call it only for such changes. The default returns false, i.e., the
+   * logger is called for every state change.
+   */
+  virtual bool watches(std::vector<SEXP> &domains) const;
+
   /**
    * returns the current value of the logger
    */
   virtual double report() = 0;
+
+  /**
+   * the current value of the logger, without the side effects of report(),
+   * e.g., resetting a transition counter
+   */
+  virtual double value() = 0;
+
+  /**
+   * The number of cells of a logger that reports a table, or 0 (the
+   * default) if it reports a single value
+   */
+  virtual size_t cells() const;
+
+  /**
+   * Report the values of the cells of a table
+   *
+   * @param values the array that the cells() values are written to
+   */
+  virtual void reportCells(double *values);
+
+  /**
+   * The reported tables in long format
+   *
+   * @param times the report times
+   *
+   * @param values the values reported at each time by reportCells()
+   *
+   * @return a data frame with the columns "times", the columns that
+   * identify a cell, and the reported values
+   */
+  virtual Rcpp::List tabulate(const Rcpp::NumericVector &times,
+                              const double *values) const;
+
+  /**
+   * Whether the logger observes the values of the simulation over time,
+   * in which case the simulation calls begin() when it starts running, and
+   * observe() after each event and before each report
+   */
+  virtual bool temporal() const;
+
+  /**
+   * Called by a simulation that starts running at the given time
+   */
+  virtual void begin(double time);
+
+  /**
+   * Called by a running simulation after an event or before a report
+   *
+   * @param time the current time of the simulation
+   *
+   * @details The events are handled in time order, but a resumed run may
+   * report at a time before the last observation.
+   */
+  virtual void observe(double time);
+
   /**
    * the name of the logger
    */
@@ -99,6 +183,7 @@ public:
    * @param from the original state of the agent before transition
    */
   virtual void log(const Agent &agent, const State &from_state);
+  virtual void log(const Agent &agent, const State &from_state, double count);
 
   /**
    * Select this counter before a state change when it may be affected.
@@ -109,6 +194,12 @@ public:
    * Update this counter after the state change has been applied.
    */
   virtual void stateChanged(const Agent &agent);
+
+  /**
+   * An occupancy counter watches the named domains of its state, whose
+   * match can only change if one of them is set.
+   */
+  virtual bool watches(std::vector<SEXP> &domains) const;
   
   /**
    * report the current state of the logger. 
@@ -120,6 +211,11 @@ public:
    * report.
    */
   virtual double report();
+
+  /**
+   * the current count
+   */
+  virtual double value();
   
   /**
    * AThe classes of a Counter object.
@@ -169,6 +265,10 @@ public:
    * @param from the original state of the agent before transition
    */
   virtual void log(const Agent &agent, const State &from_state);
+  /**
+   * Log the state of the last agent, as logging each change would
+   */
+  virtual void log(const Agent &agent, const State &from_state, double count);
   /**
    * Select an unbound state logger before a state change.
    */
@@ -182,6 +282,11 @@ public:
    */
   virtual double report();
 
+  /**
+   * the current state of the logger
+   */
+  virtual double value();
+
   /**
    * the classes of StateLogger
    */
@@ -204,4 +309,189 @@ protected:
   std::string _state;
 };
 
+/**
+ * Counts the agents by the values of a set of categorical state domains,
+ * i.e., a cross tabulation, which replaces a counter for each combination
+ * of the values.
+ *
+ * The counts are kept in a dense array, with a cell for each combination
+ * of the levels of the domains, the first domain varying fastest. A state
+ * change moves an agent from the cell of its old state to the cell of its
+ * new state, which are found from the positions of the values in the
+ * levels. An agent with a value that is not a level is not counted.
+ */
+class CrossTab : public Logger {
+public:
+  /**
+   * Constructor
+   *
+   * @param name the name of the logger
+   *
+   * @param levels a named list, the names are the domains to tabulate, and
+   * the values are character or numeric vectors of their levels
+   */
+  CrossTab(const std::string &name, const Rcpp::List &levels);
+
+  virtual void log(const Agent &agent, const State &from_state);
+  virtual void log(const Agent &agent, const State &from_state, double count);
+  virtual bool stateChanging(const Agent &agent, const Rcpp::List &state);
+  virtual void stateChanged(const Agent &agent);
+  virtual bool watches(std::vector<SEXP> &domains) const;
+
+  /**
+   * the number of agents that are counted
+   */
+  virtual double report();
+  virtual double value();
+
+  virtual size_t cells() const { return _counts.size(); }
+  virtual void reportCells(double *values);
+  virtual Rcpp::List tabulate(const Rcpp::NumericVector &times,
+                              const double *values) const;
+
+  /**
+   * the classes of CrossTab
+   */
+  static Rcpp::CharacterVector classes;
+
+protected:
+  /**
+   * the cell of a state, or -1 if a domain is missing or is not a level
+   */
+  long cell(const State &state) const;
+
+  Rcpp::List _levels;
+  /** the distance between the cells of consecutive levels of each domain */
+  std::vector<size_t> _strides;
+  std::vector<double> _counts;
+  double _total;
+  /** the cell of the agent before the state change */
+  long _from_cell;
+};
+
 typedef OwnedPointer<Logger> PLogger;
+
+/**
+ * A table of numbers indexed by the values of a set of categorical state
+ * domains, which are changed by grouped event loggers, e.g., the incidence
+ * by age group and region.
+ *
+ * The table is reported like a cross tabulation, but it does not follow
+ * the state changes of the agents.
+ */
+class EventTable : public CrossTab {
+public:
+  /**
+   * Constructor
+   *
+   * @param name the name of the table
+   *
+   * @param levels the domains and their levels, see CrossTab
+   */
+  EventTable(const std::string &name, const Rcpp::List &levels);
+
+  virtual void log(const Agent &agent, const State &from_state);
+  virtual void log(const Agent &agent, const State &from_state, double count);
+  virtual bool stateChanging(const Agent &agent, const Rcpp::List &state);
+  virtual void stateChanged(const Agent &agent);
+
+  /**
+   * An event table watches no domains, so that it is not selected for
+   * state changes
+   */
+  virtual bool watches(std::vector<SEXP> &domains) const;
+
+  /**
+   * Change the number in the cell of a state
+   *
+   * @return false if the state is not in a cell
+   */
+  bool change(const State &state, double delta);
+
+  /**
+   * Whether a table has the same domains and levels
+   */
+  bool conforms(const EventTable &table) const;
+
+  static Rcpp::CharacterVector classes;
+};
+
+/**
+ * A logger that summarizes the value of another logger over time, i.e.,
+ * its time integral, maximum or minimum between reports, or the first
+ * time that it reaches a threshold.
+ *
+ * The value of a logger is piecewise constant, changing only at events.
+ * So the summaries are exact, however sparse the report times are. An
+ * observation before the last one, i.e., a report time in the past, is
+ * taken at the time of the last one, so that time never goes back.
+ */
+class TemporalLogger : public Logger {
+public:
+  enum Statistic {
+    /** the integral of the value over the time since the last report */
+    INTEGRAL,
+    /** the maximum value since the last report */
+    MAXIMUM,
+    /** the minimum value since the last report */
+    MINIMUM,
+    /** the first time that the value reaches the threshold from the side
+     * where it started, or NA if it has not */
+    PASSAGE
+  };
+
+  /**
+   * Constructor
+   *
+   * @param name the name of the logger
+   *
+   * @param source the logger whose value is summarized, which must be
+   * updated by the simulation, i.e., added to it
+   *
+   * @param statistic the summary
+   *
+   * @param threshold the threshold of a first passage time
+   */
+  TemporalLogger(const std::string &name, PLogger source,
+                 Statistic statistic, double threshold = R_NaN);
+
+  /**
+   * The statistic of a name, "integral", "max", "min" or "passage"
+   */
+  static Statistic statistic(const std::string &name);
+
+  virtual void log(const Agent &agent, const State &from_state);
+  virtual void log(const Agent &agent, const State &from_state, double count);
+
+  /**
+   * A temporal logger watches no domains, so that it is not selected for
+   * state changes
+   */
+  virtual bool watches(std::vector<SEXP> &domains) const;
+
+  virtual bool temporal() const;
+  virtual void begin(double time);
+  virtual void observe(double time);
+
+  /**
+   * report the summary, and start the next interval for an integral, a
+   * maximum or a minimum
+   */
+  virtual double report();
+  virtual double value();
+
+  static Rcpp::CharacterVector classes;
+
+protected:
+  PLogger _source;
+  Statistic _statistic;
+  double _threshold;
+  /** the time of the last observation, NaN before the first */
+  double _time;
+  /** the value of the source since the last observation */
+  double _value;
+  double _integral, _max, _min;
+  /** whether the value started below the threshold */
+  bool _rising;
+  double _passage;
+};
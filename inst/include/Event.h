@@ -1,7 +1,9 @@
 #pragma once
 
+#include "Profile.h"
 #include "XP.h"
 #include <map>
+#include <vector>
 
 class Calendar;
 
@@ -14,6 +16,13 @@ typedef OwnedPointer<Simulation> PSimulation;
 class Event;
 typedef OwnedPointer<Event> PEvent;
 
+/**
+ * Events sorted by time, with nodes allocated from the pools
+ */
+typedef std::multimap<double, PEvent, std::less<double>,
+                      PoolAllocator<std::pair<const double, PEvent> > >
+  EventQueue;
+
 /**
  * An abstract class that represent an event.
  * 
@@ -101,7 +110,7 @@ private:
    * saves the position in the event tree of the attached agent, to 
    * speed up event unschedule.
    */
-  std::multimap<double, PEvent>::iterator _pos;
+  EventQueue::iterator _pos;
 };
 
 /**
@@ -175,6 +184,17 @@ public:
    * @param event an owning pointer to the event to be scheduled
    */
   void schedule(PEvent event);
+
+  /**
+   * Schedules a batch of events
+   *
+   * @param events owning pointers to the events to be scheduled
+   *
+   * @details This is equivalent to scheduling the events one by one, but
+   * the events are inserted in chronological order with a single update of
+   * the calendar time, which is much faster for a large batch.
+   */
+  void schedule(std::vector<PEvent> events);
   
   /**
    * Remove a scheduled event
@@ -186,6 +206,17 @@ public:
    */
   void unschedule(PEvent event);
 
+  /**
+   * Remove a batch of scheduled events
+   *
+   * @param events owning pointers to the events to be removed
+   *
+   * @details This is equivalent to unscheduling the events one by one, but
+   * the calendar time is updated only once. Events that are not scheduled
+   * in this calendar are ignored.
+   */
+  void unschedule(const std::vector<PEvent> &events);
+
   /**
    * Handle the calendar as an event
    * 
@@ -209,12 +240,28 @@ public:
    * unschedule all events scheduled to an agent
    */
   void clearEvents();
+
+  /**
+   * the number of events scheduled in this calendar
+   */
+  std::size_t size() const { return _events.size(); }
+
+  /**
+   * the events scheduled in this calendar, in chronological order
+   */
+  const EventQueue &events() const { return _events; }
   
 private:
   /**
    * Ordered events
    */
-  std::multimap<double, PEvent> _events;
+  EventQueue _events;
 };
 
 typedef OwnedPointer<Calendar> PCalendar;
+
+template<>
+struct XPExactTag<Event> : std::true_type {};
+
+template<>
+struct XPExactTag<Calendar> : std::true_type {};
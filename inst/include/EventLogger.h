@@ -28,6 +28,25 @@ public:
   virtual void log(
       Simulation &simulation, Agent &agent, ContactEvent &event) = 0;
 
+  /**
+   * Log the same event of several agents, e.g., the firings of a reaction
+   * in an aggregated population
+   *
+   * @param count the number of events
+   *
+   * @details The default logs the event count times.
+   */
+  virtual void log(Simulation &simulation, Agent &agent,
+                   TransitionEvent &event, double count);
+  virtual void log(Simulation &simulation, Agent &agent,
+                   ContactEvent &event, double count);
+
+  /**
+   * Called when a transition that uses this logger is added to a
+   * simulation. The default does nothing.
+   */
+  virtual void attach(Simulation &simulation);
+
   static Rcpp::CharacterVector classes;
 };
 
@@ -35,24 +54,93 @@ typedef OwnedPointer<EventLogger> PEventLogger;
 
 /**
  * An event logger that changes a numeric simulation state variable.
+ *
+ * The change can be filtered on the state of the event agent, either by a
+ * rule, i.e., a list of domains and values that the state must match,
+ * which is evaluated natively, or by an R function that takes the state
+ * and returns a logical value.
  */
 class StateEventLogger : public EventLogger {
 public:
+  /**
+   * Constructor
+   *
+   * @param variable the name of the simulation state variable
+   *
+   * @param change the change of the variable
+   *
+   * @param filter R_NilValue, a rule (an R list) or an R function
+   */
   StateEventLogger(
       const std::string &variable,
       double change,
-      Rcpp::Nullable<Rcpp::Function> filter = R_NilValue);
+      SEXP filter = R_NilValue);
 
   virtual void log(
       Simulation &simulation, Agent &agent, TransitionEvent &event);
   virtual void log(
       Simulation &simulation, Agent &agent, ContactEvent &event);
+  virtual void log(Simulation &simulation, Agent &agent,
+                   TransitionEvent &event, double count);
+  virtual void log(Simulation &simulation, Agent &agent,
+                   ContactEvent &event, double count);
 
 protected:
-  void apply(Simulation &simulation, Agent &agent);
+  /** make the change count times, if the agent matches the filter */
+  virtual void apply(Simulation &simulation, Agent &agent, double count);
   bool matches(const Agent &agent) const;
 
   std::string _variable;
+  /** the interned name of the variable */
+  Rcpp::CharacterVector _symbol;
   double _change;
-  Rcpp::Nullable<Rcpp::Function> _filter;
+  /** the rule of the filter, empty if there is none */
+  Rcpp::List _rule;
+  /** the R function of the filter, or R_NilValue */
+  Rcpp::RObject _filter;
+};
+
+class EventTable;
+
+/**
+ * An event logger that changes the number in the cell of the event agent
+ * in a table indexed by categorical state domains, e.g., to count the
+ * incidence by age group and region.
+ *
+ * The table is a report logger, which is added to the simulation with the
+ * transition, and is shared by the grouped event loggers with the same
+ * name. The cell is found from the state of the agent without calling R
+ * or allocating R objects.
+ */
+class GroupedEventLogger : public StateEventLogger {
+public:
+  /**
+   * Constructor
+   *
+   * @param name the name of the table
+   *
+   * @param change the change of the number in the cell
+   *
+   * @param levels a named list of the domains and their levels
+   *
+   * @param filter R_NilValue, a rule or an R function, see StateEventLogger
+   */
+  GroupedEventLogger(
+      const std::string &name,
+      double change,
+      const Rcpp::List &levels,
+      SEXP filter = R_NilValue);
+
+  virtual ~GroupedEventLogger();
+
+  /**
+   * Add the table to the simulation, or use the table with the same name
+   * in the simulation
+   */
+  virtual void attach(Simulation &simulation);
+
+protected:
+  virtual void apply(Simulation &simulation, Agent &agent, double count);
+
+  OwnedPointer<EventTable> _table;
 };
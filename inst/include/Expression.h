@@ -0,0 +1,153 @@
+#pragma once
+
+#include "Callback.h"
+#include "RNG.h"
+#include <Rcpp.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * A restricted R expression compiled into a bytecode that is evaluated
+ * against the states of an agent and, optionally, its contact.
+ *
+ * The expression may use
+ *   - numeric, logical and character constants
+ *   - time: the current simulation time
+ *   - state$x and contact$x: the domain x of the state of the agent or of
+ *     the contact, and a bare name x for state$x
+ *   - .env$x or !!x: a variable in the environment of the expression
+ *     holding a scalar, which is looked up once at compilation
+ *   - lookup tables p[i] (or p[[i]]), where p is a vector in the environment
+ *     of the expression, and i is a 1-based index or a name
+ *   - arithmetic + - * / ^ %% %/%, comparisons == != < <= > >=, and the
+ *     logical operators ! & | && ||
+ *   - ifelse(c, a, b), which is NA if c is NA, and if (c) a else b, which
+ *     is an error if c is NA
+ *   - the functions abs, exp, log, sqrt, floor, ceiling, round, min, max,
+ *     is.na, and runif() for a uniform random number
+ *   - assignments state$x <- value and contact$x <- value, and blocks
+ *     enclosed by braces
+ * A missing domain is NA, and compares as NA with a value of any type.
+ */
+class Expression {
+public:
+  /**
+   * Compile an expression
+   *
+   * @param expr the R expression (a language object, symbol or constant)
+   *
+   * @param env the environment to look up variables and lookup tables
+   */
+  Expression(SEXP expr, SEXP env);
+
+  /**
+   * Evaluate the expression
+   *
+   * @param time the current simulation time
+   *
+   * @param agent the agent whose state is accessed by state$x
+   *
+   * @param contact the contact whose state is accessed by contact$x, or
+   * nullptr
+   *
+   * @return the value of the expression as a logical value. NA is false.
+   *
+   * @details If the value is true, the assignments are applied to the
+   * agents after the expression is evaluated, with one state change for
+   * each agent. Otherwise they are discarded, as the transition does not
+   * happen.
+   */
+  bool evaluate(double time, Agent &agent, Agent *contact);
+
+  /**
+   * Evaluate the expression for its assignments only, ignoring its value
+   */
+  void run(double time, Agent &agent, Agent *contact);
+
+  /** Whether the expression assigns to a state */
+  bool hasEffects() const { return _has_effects; }
+
+private:
+  struct Value {
+    enum Type { NUMBER, LOGICAL, STRING } type;
+    double number;
+    SEXP string;
+  };
+
+  enum OpCode {
+    CONST, TIME, LOAD, STORE, INDEX, POP,
+    ADD, SUB, MUL, DIV, POW, MOD, IDIV, NEG,
+    EQ, NE, LT, LE, GT, GE, NOT, AND, OR,
+    JUMP, JUMP_UNLESS, BRANCH, AND_JUMP, OR_JUMP,
+    CALL1, ISNA, MIN, MAX, RUNIF
+  };
+
+  struct Instruction {
+    OpCode op;
+    int arg;
+  };
+
+  struct Field {
+    SEXP name;
+    bool contact;
+    R_xlen_t hint;
+  };
+
+  struct Table {
+    Rcpp::RObject values;
+    std::unordered_map<SEXP, R_xlen_t> positions;
+  };
+
+  void compile(SEXP expr);
+  void compileCall(const std::string &f, SEXP args);
+  void emit(OpCode op, int arg = 0) { _code.push_back({op, arg}); }
+  int constant(const Value &value);
+  int constant(SEXP value, const std::string &name);
+  int field(SEXP name, bool contact);
+  int table(SEXP symbol);
+  SEXP lookup(SEXP symbol) const;
+
+  void execute(double time, Agent &agent, Agent *contact);
+  Value load(int field, const Agent &agent, const Agent *contact);
+  Value index(const Table &table, const Value &i) const;
+  static bool truth(const Value &value, bool &na);
+  static bool isNA(const Value &value);
+  static Value logical(bool value, bool na = false);
+  static Value number(double value);
+  static double asNumber(const Value &value);
+  static SEXP asSEXP(const Value &value);
+  static Value asValue(SEXP x);
+  static Value compare(OpCode op, const Value &x, const Value &y);
+  Rcpp::List updates(std::vector<std::pair<int, Value>> &updates) const;
+  void apply(Agent &agent, Agent *contact);
+
+  Rcpp::Environment _env;
+  std::vector<Instruction> _code;
+  std::vector<Value> _constants;
+  std::vector<Rcpp::RObject> _protected;
+  std::vector<Field> _fields;
+  std::vector<Table> _tables;
+  std::vector<Value> _stack;
+  std::vector<std::pair<int, Value>> _agent_updates;
+  std::vector<std::pair<int, Value>> _contact_updates;
+  bool _has_effects;
+  RUnif _unif;
+};
+
+/**
+ * A callback that evaluates a compiled expression
+ */
+class ExpressionCallback : public Callback {
+public:
+  /**
+   * @param formula a one-sided formula holding the expression
+   */
+  ExpressionCallback(SEXP formula);
+
+  virtual bool toChange(double time, Agent &agent, Agent *contact);
+  virtual void changed(double time, Agent &agent, Agent *contact);
+
+protected:
+  Expression _expression;
+};
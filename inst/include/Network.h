@@ -34,6 +34,8 @@ public:
    * @param agent the agent to add
    */
   virtual void add(Agent &agent);
+
+  using Contact::add;
   
   /**
    * remove an agent
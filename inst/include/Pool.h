@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+/**
+ * A free-list allocator for small objects of a fixed size.
+ *
+ * Blocks are carved out of slabs, i.e., contiguous arrays of SLAB_SIZE
+ * bytes, so that objects allocated together (e.g., the agents of a
+ * population) are placed next to each other, without the per-allocation
+ * header of the general heap. A slab is aligned to its size and starts with
+ * a header, which a released block finds by masking its address. The
+ * blocks of a slab are handed out in address order, so that its pages are
+ * only touched as they are needed, and its released blocks are kept in a
+ * free list for reuse. A slab whose blocks
+ * have all been released is returned to the system, except a spare slab if
+ * the other slabs are nearly full, so that the memory of a large simulation
+ * is released when its agents are destroyed.
+ *
+ * The saving over the general heap is its per-allocation header, i.e.,
+ * 9% to 25% of the memory of the objects, depending on their size.
+ *
+ * The pools for the different size classes are shared by all simulations.
+ * They are not thread safe.
+ */
+class Pool {
+public:
+  /**
+   * The largest object size that is allocated from a pool. Larger objects
+   * are allocated from the general heap.
+   */
+  static constexpr std::size_t MAX_SIZE = 256;
+
+  /**
+   * The granularity of the size classes
+   */
+  static constexpr std::size_t ALIGNMENT = 16;
+
+  /**
+   * The size of a slab in bytes, a power of 2
+   */
+  static constexpr std::size_t SLAB_SIZE = 1 << 20;
+
+  /**
+   * Constructor
+   *
+   * @param size the size of a block, a multiple of ALIGNMENT
+   */
+  explicit Pool(std::size_t size);
+
+  Pool(const Pool &) = delete;
+  Pool &operator=(const Pool &) = delete;
+
+  /** allocate a block */
+  void *allocate();
+
+  /** return a block to the free list of its slab */
+  void release(void *p);
+
+  /** the size of a block */
+  std::size_t size() const { return _size; }
+
+  /** the number of blocks in use */
+  std::size_t used() const { return _used; }
+
+  /** the number of blocks in all slabs */
+  std::size_t capacity() const { return _capacity; }
+
+  /** the number of slabs */
+  std::size_t slabs() const { return _slabs; }
+
+  /** Free the slabs that have no blocks in use. */
+  ~Pool();
+
+  /**
+   * Allocate an object of the given size from the pool of its size class,
+   * or from the general heap if it is too large.
+   */
+  static void *allocate(std::size_t size);
+
+  /**
+   * Release an object allocated by allocate(size).
+   */
+  static void release(void *p, std::size_t size);
+
+  /**
+   * The pool of the size class of size, or nullptr if the size is too large
+   */
+  static Pool *of(std::size_t size);
+
+  /**
+   * The size of the block that holds an object of the given size
+   */
+  static std::size_t blockSize(std::size_t size)
+  {
+    return size > MAX_SIZE ? size :
+      (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  }
+
+private:
+  struct Block {
+    Block *next;
+  };
+
+  /**
+   * The header of a slab, which is in the list of the available slabs while
+   * it has free blocks
+   */
+  struct Slab {
+    std::size_t used;
+    /** the released blocks */
+    Block *free;
+    /** the blocks that have never been allocated, from fresh to end */
+    char *fresh, *end;
+    Slab *previous, *next;
+  };
+
+  /** the slab that holds a block */
+  static Slab *slab(void *p)
+  {
+    return reinterpret_cast<Slab*>(
+      reinterpret_cast<std::uintptr_t>(p) & ~(SLAB_SIZE - 1));
+  }
+
+  /** allocate a slab, and make it the first available slab */
+  void grow();
+
+  /** add a slab to the front of the available slabs */
+  void push(Slab *slab);
+
+  /** remove a slab from the available slabs */
+  void remove(Slab *slab);
+
+  /** the available slabs, from which blocks are allocated in order */
+  Slab *_available;
+  std::size_t _size;
+  /** the number of blocks in a slab, after its header */
+  std::size_t _blocks;
+  std::size_t _used;
+  std::size_t _capacity;
+  std::size_t _slabs;
+};
+
+/**
+ * A standard allocator that allocates single objects from the pools, used
+ * for the nodes of node-based containers such as the calendar of events.
+ */
+template<class T>
+class PoolAllocator {
+public:
+  typedef T value_type;
+
+  PoolAllocator() noexcept = default;
+
+  template<class U>
+  PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+  T *allocate(std::size_t n)
+  {
+    if (n != 1)
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    return static_cast<T*>(Pool::allocate(sizeof(T)));
+  }
+
+  void deallocate(T *p, std::size_t n) noexcept
+  {
+    if (n != 1)
+      ::operator delete(p);
+    else Pool::release(p, sizeof(T));
+  }
+
+  template<class U>
+  bool operator==(const PoolAllocator<U> &) const noexcept { return true; }
+
+  template<class U>
+  bool operator!=(const PoolAllocator<U> &) const noexcept { return false; }
+};
@@ -5,6 +5,7 @@
 #include <vector>
 #include <string>
 #include <list>
+#include <unordered_set>
 #include <utility>
 #include <Rcpp.h>
 
@@ -51,6 +52,9 @@ public:
    * 
    * @details The length of the list is the population size, and each element
    * corresponds to the state of the agent at the corresponding index. 
+   * 
+   * If states is a data frame, then each row gives the state of an agent,
+   * with one domain for each column. The agents are created in bulk.
    */
   Population(Rcpp::List states);
 
@@ -78,6 +82,31 @@ public:
    * patterns
    */
   PAgent remove(Agent &agent);
+
+  /**
+   * Add a batch of agents to the population
+   *
+   * @param agents owning pointers to the agents to be added
+   *
+   * @details This is equivalent to adding the agents one by one, in order,
+   * except that the agents are scheduled in the population in bulk, and
+   * each contact pattern is notified once with all the new agents, after
+   * they have joined the population.
+   */
+  void add(const std::vector<PAgent> &agents);
+
+  /**
+   * Remove a batch of agents from the population
+   *
+   * @param agents the agents to be removed
+   *
+   * @return owning pointers to the removed agents, in the same order
+   *
+   * @details This is equivalent to calling leave() on each agent, in order,
+   * except that the agents are unscheduled from the population in bulk.
+   * All the agents must be in this population.
+   */
+  std::vector<PAgent> remove(const std::vector<Agent*> &agents);
   
   /**
    * Add a contact pattern
@@ -144,13 +173,69 @@ public:
    */
   void report() override;
 
+  /**
+   * The memory used by the agents in a population
+   */
+  struct Footprint {
+    /** the number of agents, excluding subpopulations */
+    std::size_t agents = 0;
+    /** the bytes used by the agent objects and their contact calendars */
+    std::size_t agent_bytes = 0;
+    /** the number of scheduled events */
+    std::size_t events = 0;
+    /** the bytes used by the events and their calendar entries */
+    std::size_t event_bytes = 0;
+    /** the number of distinct R objects in the states */
+    std::size_t state_objects = 0;
+    /** the estimated bytes used by the R objects in the states */
+    std::size_t state_bytes = 0;
+    /** the R objects already counted */
+    std::unordered_set<SEXP> counted;
+  };
+
+  /**
+   * Add the memory used by the agents in this population and its
+   * subpopulations to a footprint
+   */
+  void footprint(Footprint &footprint) const;
+
 protected:
   friend class Simulation;
 
   /**
-   * Normalize one initial state and add its agent to this population.
+   * Normalize one initial state and create its agent.
    */
-  void addInitialAgent(SEXP state);
+  static PAgent initialAgent(SEXP state);
+
+  /**
+   * Add newly created agents to this population in bulk
+   *
+   * @details the agents are scheduled as a batch. They must not be in any
+   * population, and have no state to report, which is the case for agents
+   * created by a constructor.
+   */
+  void addInitialAgents(const std::vector<PAgent> &agents);
+
+  /**
+   * Create agents from the rows of a data frame, and add them in bulk
+   */
+  void addInitialAgents(const Rcpp::DataFrame &data);
+
+  /**
+   * Reserve storage in the agent list for n more agents
+   *
+   * @details The agent objects allocated one after another are contiguous
+   * in the slabs of their pool, which are not reserved ahead.
+   */
+  void reserve(size_t n);
+
+  /**
+   * Remove an agent from the agent list and the contact patterns, without
+   * unscheduling it
+   *
+   * @return the owning pointer to the agent
+   */
+  PAgent extract(Agent &agent);
 
   /**
    * Assign IDs to this population and all agents contained by it.
@@ -189,3 +274,6 @@ protected:
 };
 
 typedef OwnedPointer<Population> PPopulation;
+
+template<>
+struct XPExactTag<Population> : std::true_type {};
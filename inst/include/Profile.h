@@ -0,0 +1,141 @@
+#pragma once
+
+#include <Rcpp.h>
+#include <chrono>
+#include <cstddef>
+
+/**
+ * Counts and timers for the hot paths of a simulation.
+ *
+ * Profiling is disabled by default. While a simulation with profiling
+ * enabled is running, current() returns its profile and the instrumented
+ * code records into it. Otherwise each instrumentation point only tests a
+ * null pointer.
+ */
+class Profile {
+public:
+  /**
+   * The quantities that are counted (and, for some, timed).
+   */
+  enum Metric {
+    TRANSITION_EVENT,
+    CONTACT_EVENT,
+    DEATH_EVENT,
+    R_EVENT,
+    BATCH_EVENT,
+    REACTION_EVENT,
+    SCHEDULE,
+    UNSCHEDULE,
+    CASCADE,
+    RULE_MATCH,
+    STALE_CONTACT,
+    R_CALLBACK,
+    RNG_REFILL,
+    RESUME,
+    N_METRICS
+  };
+
+  Profile();
+
+  /**
+   * Clear all counts and times.
+   */
+  void reset();
+
+  /**
+   * Increase the count of a metric
+   */
+  void count(Metric metric, std::size_t n = 1) { _count[metric] += n; }
+
+  /**
+   * Add elapsed seconds to a timed metric
+   */
+  void time(Metric metric, double seconds) { _time[metric] += seconds; }
+
+  /**
+   * Record the nesting depth of a calendar cascade
+   */
+  void depth(std::size_t depth)
+  {
+    if (depth > _max_depth) _max_depth = depth;
+  }
+
+  /**
+   * Return the metrics as a data.frame with columns metric, count and time
+   */
+  Rcpp::DataFrame report() const;
+
+  /**
+   * The profile that is recording, or nullptr if profiling is disabled.
+   */
+  static Profile *current() { return _current; }
+
+  /**
+   * Increase the count of a metric in the current profile, if any.
+   */
+  static void record(Metric metric)
+  {
+    if (_current != nullptr) _current->count(metric);
+  }
+
+  /**
+   * Makes a profile current for the lifetime of this object.
+   *
+   * @details The previously current profile is restored on destruction,
+   * so a nested run of another simulation does not record into this one.
+   */
+  class Scope {
+  public:
+    explicit Scope(Profile *profile);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    Profile *_previous;
+  };
+
+  /**
+   * Counts and times a section of code for the current profile.
+   */
+  class Timer {
+  public:
+    explicit Timer(Metric metric);
+    ~Timer();
+    Timer(const Timer &) = delete;
+    Timer &operator=(const Timer &) = delete;
+
+  private:
+    Profile *_profile;
+    Metric _metric;
+    std::chrono::steady_clock::time_point _start;
+  };
+
+  /**
+   * Tracks the nesting depth of calendar updates.
+   */
+  class Cascade {
+  public:
+    Cascade() : _profile(_current)
+    {
+      if (_profile != nullptr) _profile->depth(++_profile->_depth);
+    }
+    ~Cascade()
+    {
+      if (_profile != nullptr) --_profile->_depth;
+    }
+    Cascade(const Cascade &) = delete;
+    Cascade &operator=(const Cascade &) = delete;
+
+  private:
+    Profile *_profile;
+  };
+
+private:
+  double _count[N_METRICS];
+  double _time[N_METRICS];
+  std::size_t _depth;
+  std::size_t _max_depth;
+
+  static Profile *_current;
+};
@@ -2,9 +2,12 @@
 
 #include "Population.h"
 #include "Counter.h"
+#include "StateIndex.h"
+#include "StopCondition.h"
 #include "Transition.h"
 #include <list>
 #include <map>
+#include <memory>
 #include <vector>
 
 class Simulation : public Population {
@@ -89,6 +92,42 @@ public:
    */
   void add(PLogger counter);
 
+  /**
+   * The logger with a given name, or nullptr if there is none
+   */
+  PLogger logger(const std::string &name) const;
+
+  /**
+   * Add a condition that stops the simulation before its last report time
+   *
+   * @details The conditions are checked before each event is handled. When
+   * one is met, resume() returns the reports up to the time of the stop,
+   * and stopReason() gives the reason.
+   */
+  void addStopCondition(std::unique_ptr<StopCondition> condition);
+
+  /**
+   * Remove all stop conditions
+   */
+  void clearStopConditions();
+
+  /**
+   * The reason that the last run stopped early, or an empty string if it
+   * reached its last report time
+   */
+  const std::string &stopReason() const { return _stop_reason; }
+
+  /**
+   * The number of events handled by the current or last run
+   */
+  double handledEvents() const { return _handled; }
+
+  /**
+   * A handle of this simulation that is valid for a callback scope, which
+   * is created on first use and reused for later scopes
+   */
+  SEXP borrowSimulation(const XPScope &scope);
+
   /**
    * Add a Transition rule a simulation
    * 
@@ -106,9 +145,85 @@ public:
    * This operation does not notify agent-state loggers or transition rules.
    */
   void change(const std::string &name, double delta);
+
+  /**
+   * Add a numeric change to a simulation state variable given by its
+   * interned name, a CHARSXP, without allocating a list.
+   */
+  void change(SEXP name, double delta);
+
+  /**
+   * Report a state change of an agent to the loggers only
+   *
+   * @param agent an agent that is not managed by the simulation, e.g., one
+   * standing for an individual in an aggregated population
+   *
+   * @param from the state of the agent before the change
+   *
+   * @details Unlike a state change of an agent in the simulation, this does
+   * not schedule the transitions of the agent or update the indexes.
+   */
+  void log(Agent &agent, const State &from);
+
+  /**
+   * Report the same state change of several agents to the loggers only,
+   * e.g., of the individuals in a compartment of an aggregated population
+   *
+   * @param count the number of agents
+   *
+   * @details The loggers count the changes at once, see Logger::log().
+   */
+  void log(Agent &agent, const State &from, double count);
+
+  /**
+   * The current time of a running simulation, or NaN if it has not run
+   */
+  double currentTime() const { return _current_time; }
+
+  /**
+   * The spontaneous transition rules
+   */
+  const std::list<Transition*> &transitions() const { return _transitions; }
+
+  /**
+   * The contact transition rules
+   */
+  const std::list<ContactTransition*> &contactTransitions() const
+  {
+    return _contact_transitions;
+  }
   
   using Population::add;
 
+  /**
+   * Index the agents by the values of a set of state domains
+   *
+   * @param domains the names of the state domains
+   *
+   * @details The index is built from the agents currently in the simulation,
+   * and is then updated whenever the state of an agent changes. Adding an
+   * index on the same domains again does nothing.
+   */
+  void addIndex(const std::vector<std::string> &domains);
+
+  /**
+   * The number of agents that match a rule, using an index that covers
+   * the domains in the rule
+   */
+  size_t count(const Rcpp::List &rule);
+
+  /**
+   * Sample k agents that match a rule uniformly without replacement, using
+   * an index that covers the domains in the rule
+   */
+  std::vector<Agent*> sample(const Rcpp::List &rule, size_t k);
+
+  /**
+   * Remove the agents in a population that leaves the simulation, and
+   * those in its subpopulations, from the indexes
+   */
+  void unindex(Population &population);
+
   /**
    * Get the next unique ID in the simulation
    * 
@@ -118,6 +233,21 @@ public:
    */
   unsigned int nextID() { return ++_next_id; }
 
+  /**
+   * Enable or disable profiling
+   * 
+   * @param enabled whether to record the profile in subsequent runs
+   * 
+   * @details Turning profiling on when it is off clears the counts and
+   * times recorded so far.
+   */
+  void setProfiling(bool enabled);
+
+  /**
+   * The profile recorded while profiling is enabled
+   */
+  const Profile &profile() const { return _profile; }
+
   /** the simulation that it is in */
   Simulation *simulation() override;
   /** the simulation that it is in */
@@ -151,17 +281,64 @@ protected:
    * @param from the state of the agent before the change.
    */
   void stateChanged(Agent &agent, const State &from) override;
+
+  /**
+   * The index that covers the domains of a rule
+   */
+  StateIndex &index(const Rcpp::List &rule);
+
+  /**
+   * Add the agents in a population, and those in its subpopulations, to an
+   * index
+   */
+  void index(Population &population, StateIndex &index);
+
+  /**
+   * Whether a stop condition is met, in which case the reason is saved
+   */
+  bool stopping();
+
+  /**
+   * Pass the current time to the temporal loggers
+   */
+  void observe();
   
+  /**
+   * The loggers that watch a state domain
+   */
+  struct Watch {
+    /** the name of the domain, held by the loggers */
+    SEXP domain;
+    std::vector<Logger*> loggers;
+  };
+
   std::list<PLogger> _loggers;
+  /** the loggers that observe the simulation over time */
+  std::vector<Logger*> _temporal_loggers;
+  /** the loggers that are selected for every state change */
+  std::vector<Logger*> _polled_loggers;
+  /** the other loggers, by the domains that they watch */
+  std::vector<Watch> _watches;
   std::vector<Logger*> _pending_loggers;
   std::vector<Transition*> _pending_transitions;
   std::vector<ContactTransition*> _pending_contact_transitions;
   std::list<Transition*> _transitions;
   std::list<ContactTransition*> _contact_transitions;
+  std::list<StateIndex> _indexes;
+  std::vector<std::unique_ptr<StopCondition> > _stop_conditions;
+  std::string _stop_reason;
+  double _handled;
   double _current_time;
+  Profile _profile;
+  bool _profiling;
+  /** the handle passed to the event handlers, created on first use */
+  std::unique_ptr<XPHandle<Simulation> > _simulation_handle;
   
   /**
    * The next unique ID
    */
   unsigned int _next_id;
 };
+
+template<>
+struct XPExactTag<Simulation> : std::true_type {};
@@ -2,9 +2,17 @@
 
 #include <Rcpp.h>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 /**
  * Represents the state of an agent as an R list
+ *
+ * The names of the domains are CHARSXPs, which R interns in its global
+ * cache, i.e., a name with a given encoding is a unique object. So the
+ * domains are looked up by comparing the name objects, which neither
+ * converts them to C++ strings nor compares their characters.
  */
 class State : public Rcpp::List {
 public:
@@ -90,6 +98,154 @@ public:
    * @details the values must be either character or numeric vectors.
    */
   bool match(const Rcpp::List &rule) const;
+
+  /**
+   * The position of a domain
+   *
+   * @param name the name of the domain, a CHARSXP
+   *
+   * @return the position of the first domain with the name, or -1 if the
+   * state does not have the domain
+   */
+  R_xlen_t find(SEXP name) const;
+
+  /**
+   * The interned name of a domain, as a CHARSXP
+   *
+   * @details The result must be protected, e.g., by storing it in a
+   * character vector, while it is in use.
+   */
+  static SEXP symbol(const std::string &name);
+
+  /**
+   * Whether two domain names, CHARSXPs, are the same
+   *
+   * @details Two names with the same encoding are the same only if they are
+   * the same object in the CHARSXP cache of R. Names with different
+   * encodings are compared as UTF-8 strings.
+   */
+  static bool same(SEXP x, SEXP y);
+
+private:
+  /**
+   * Append the given domains of a list, whose names are not in this state
+   */
+  void append(const Rcpp::List &y, const std::vector<R_xlen_t> &domains);
+};
+
+/**
+ * The state of an agent, interned in a table of the distinct states, so
+ * that the agents in the same state share one R list.
+ *
+ * A model with many agents usually has few distinct states, e.g., the
+ * stages of an epidemic. Holding one R list per agent would leave R's
+ * garbage collector with several live objects for each agent, and each
+ * change would allocate. Instead, a change looks up the resulting state in
+ * the table, comparing its values without building it, and a new R list
+ * is only created for a state that no agent is in. The shared lists are
+ * not mutable, so R copies them before modifying them.
+ *
+ * A state that is not in the table is only added to it if a state with
+ * the same hash has been seen recently. Otherwise, e.g., for a state with
+ * an agent id, the agent owns its R list, which is changed in place as
+ * long as R does not hold it.
+ */
+class SharedState {
+public:
+  /**
+   * Constructor for an empty state
+   */
+  SharedState();
+
+  /**
+   * Constructor that interns a state
+   */
+  SharedState(const State &state);
+
+  SharedState(const SharedState &other);
+
+  ~SharedState();
+
+  SharedState &operator=(const SharedState &other);
+
+  /**
+   * Replace the state by an interned state
+   */
+  SharedState &operator=(const State &state);
+
+  /**
+   * Set values of domains given by list, as State::operator&=() does
+   */
+  SharedState &operator&=(const Rcpp::List &state);
+
+  /** the state */
+  const State &get() const { return _entry->state; }
+
+  operator const State &() const { return _entry->state; }
+
+  /**
+   * checks if the state contains identical values in the given list
+   * for corresponding domains, see State::match()
+   */
+  bool match(const Rcpp::List &rule) const
+  {
+    return _entry->state.match(rule);
+  }
+
+  /**
+   * A state that is not shared, which can be modified in place, e.g., the
+   * state of a simulation that event loggers change. The state is copied
+   * if it is shared, or if R may hold it, e.g., from getState(). It is
+   * interned again when it is replaced or merged.
+   */
+  State &own();
+
+private:
+  struct Entry {
+    State state;
+    size_t hash;
+    size_t owners;
+    /** whether the entry is in the table, i.e., shared */
+    bool shared;
+  };
+
+  /** whether the state is owned by this object alone, and not held by R */
+  bool owned() const
+  {
+    return !_entry->shared && _entry->owners == 1 &&
+      !MAYBE_SHARED(_entry->state);
+  }
+
+  /** the values that replace those of a state, by their positions */
+  typedef std::vector<std::pair<R_xlen_t, SEXP> > Changes;
+
+  /** find or add an entry for a state, and retain it */
+  static Entry *intern(const State &state, bool copy);
+
+  /** find the entry of a state with the given changes, or nullptr */
+  static Entry *lookup(size_t hash, const State &state,
+                       const Changes &changes);
+
+  /** add an entry, to the table if it is shared */
+  static Entry *insert(const State &state, size_t hash, bool shared);
+
+  /**
+   * Whether a state with the hash has been seen recently, i.e., whether a
+   * new state is worth sharing. The hash is remembered.
+   */
+  static bool repeated(size_t hash);
+
+  static void retain(Entry *entry) { ++entry->owners; }
+
+  static void release(Entry *entry);
+
+  /** the shared entries by their hashes */
+  static std::unordered_multimap<size_t, Entry*> &table();
+
+  /** the entry of the empty state, which is never released */
+  static Entry *empty();
+
+  Entry *_entry;
 };
 
 extern "C" {
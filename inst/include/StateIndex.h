@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Agent.h"
+#include "RNG.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * An index of the agents in a simulation by the values of a set of
+ * categorical state domains.
+ *
+ * The agents are grouped into buckets, one for each combination of the
+ * values of the indexed domains. The simulation updates the index whenever
+ * the state of an agent changes, so that the agents matching a rule on the
+ * indexed domains can be counted and sampled without scanning the
+ * population.
+ *
+ * Only scalar character, integer and numeric values are indexed. An agent
+ * whose state has none of the indexed domains, e.g., an agent that has left
+ * the simulation, is not in the index.
+ */
+class StateIndex {
+public:
+  /**
+   * Constructor
+   *
+   * @param domains the names of the state domains to index
+   */
+  StateIndex(const std::vector<std::string> &domains);
+
+  /**
+   * The names of the indexed domains
+   */
+  const std::vector<std::string> &domains() const { return _domains; }
+
+  /**
+   * Whether all domains in a rule are indexed
+   */
+  bool covers(const Rcpp::List &rule) const;
+
+  /**
+   * Move an agent to the bucket of its current state
+   */
+  void update(Agent &agent);
+
+  /**
+   * Remove an agent from the index
+   */
+  void remove(Agent &agent);
+
+  /**
+   * The number of agents that match a rule
+   *
+   * @details This takes constant time if the rule specifies all indexed
+   * domains, and is proportional to the number of distinct combinations of
+   * values otherwise.
+   */
+  size_t count(const Rcpp::List &rule) const;
+
+  /**
+   * Sample agents that match a rule uniformly without replacement
+   *
+   * @param rule the rule to match
+   *
+   * @param k the number of agents to sample
+   *
+   * @return k agents, or all matching agents if fewer than k match
+   */
+  std::vector<Agent*> sample(const Rcpp::List &rule, size_t k);
+
+private:
+  typedef std::vector<Agent*> Bucket;
+  typedef std::unordered_map<std::string, Bucket> Buckets;
+
+  /**
+   * The key of a state, each domain encoded in a fixed width
+   */
+  std::string key(const Rcpp::List &state) const;
+
+  /**
+   * The partial key of a rule, and the positions of the specified domains
+   */
+  std::string key(const Rcpp::List &rule, std::vector<size_t> &positions)
+    const;
+
+  /**
+   * Whether the key of a bucket agrees with a partial key
+   */
+  bool agrees(const std::string &key, const std::string &partial,
+              const std::vector<size_t> &positions) const;
+
+  /**
+   * The buckets that match a rule
+   */
+  std::vector<const Bucket*> buckets(const Rcpp::List &rule) const;
+
+  /**
+   * The bucket of an agent and its position in the bucket. The elements of
+   * an unordered map are not moved by rehashing.
+   */
+  struct Entry {
+    Buckets::value_type *bucket;
+    size_t position;
+  };
+
+  std::vector<std::string> _domains;
+  Buckets _buckets;
+  std::unordered_map<Agent*, Entry> _entries;
+  RUnif _unif;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Counter.h"
+#include <chrono>
+#include <string>
+
+class Simulation;
+
+/**
+ * A condition that stops a running simulation before its last report time.
+ *
+ * The conditions of a simulation are checked in C++ before each event is
+ * handled, so that a run can end as soon as its outcome is known, e.g.,
+ * when an epidemic goes extinct, without calling R for each event.
+ */
+class StopCondition {
+public:
+  virtual ~StopCondition();
+
+  /**
+   * Called when the simulation starts or resumes running
+   */
+  virtual void start();
+
+  /**
+   * Whether the simulation should stop
+   */
+  virtual bool met(Simulation &sim) = 0;
+
+  /**
+   * A description of the condition, returned as the reason of the stop
+   */
+  virtual std::string reason() const = 0;
+};
+
+/**
+ * Stops a simulation when the value of a logger falls to a lower threshold
+ * or rises to an upper threshold
+ */
+class LoggerStop : public StopCondition {
+public:
+  /**
+   * Constructor
+   *
+   * @param logger the logger, whose value is checked without resetting it
+   *
+   * @param below stop when the value is less than or equal to this
+   *
+   * @param above stop when the value is greater than or equal to this
+   */
+  LoggerStop(PLogger logger, double below, double above);
+
+  virtual bool met(Simulation &sim);
+  virtual std::string reason() const;
+
+private:
+  PLogger _logger;
+  double _below, _above;
+  /** the value that met the condition */
+  double _value;
+};
+
+/**
+ * Stops a simulation when the number of agents matching a rule, as counted
+ * by a state index, falls to a lower threshold or rises to an upper
+ * threshold
+ */
+class CountStop : public StopCondition {
+public:
+  /**
+   * Constructor
+   *
+   * @param rule the rule, which must be covered by a state index of the
+   * simulation
+   *
+   * @param below stop when the count is less than or equal to this
+   *
+   * @param above stop when the count is greater than or equal to this
+   */
+  CountStop(const Rcpp::List &rule, double below, double above);
+
+  virtual bool met(Simulation &sim);
+  virtual std::string reason() const;
+
+private:
+  Rcpp::List _rule;
+  double _below, _above;
+  double _value;
+};
+
+/**
+ * Stops a simulation when a run has taken a given wall-clock time, or has
+ * handled a given number of events
+ */
+class BudgetStop : public StopCondition {
+public:
+  /**
+   * Constructor
+   *
+   * @param seconds the wall-clock time budget of each run in seconds
+   *
+   * @param events the number of events that each run may handle
+   */
+  BudgetStop(double seconds, double events);
+
+  virtual void start();
+  virtual bool met(Simulation &sim);
+  virtual std::string reason() const;
+
+private:
+  double _seconds, _events;
+  /** the number of times the condition has been checked */
+  size_t _checks;
+  std::chrono::steady_clock::time_point _start;
+  bool _out_of_time;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Callback.h"
 #include "Contact.h"
 #include "EventLogger.h"
 #include "RNG.h"
@@ -48,20 +49,73 @@ public:
  */
 class TransitionBase {
 public:
+  virtual ~TransitionBase();
+
   const Rcpp::List &from() const { return _from; }
   const Rcpp::List &to() const { return _to; }
 
+  /**
+   * Whether the to_change callback is a BatchCallback, whose events are
+   * deferred and evaluated together
+   */
+  bool batched() const { return _batch != nullptr; }
+
+  /**
+   * Whether the rule has a to_change or a changed callback
+   */
+  bool hasCallbacks() const
+  {
+    return _to_change != nullptr || _changed != nullptr;
+  }
+
+  /**
+   * Evaluate the deferred events and apply the accepted transitions
+   *
+   * @param sim the simulation object
+   *
+   * @param time the current simulation time, at which the transitions
+   * happen
+   *
+   * @details This is called by a BatchEvent at the end of the time window
+   * of the first deferred event.
+   */
+  virtual void flush(Simulation &sim, double time) = 0;
+
+  /**
+   * Defer the to_change callback of an event to the end of the time
+   * window, and schedule a BatchEvent if it is the first deferred event
+   *
+   * @param sim the simulation object
+   *
+   * @param event the event being handled
+   *
+   * @param agent the agent that the event is attached to
+   */
+  void defer(Simulation &sim, PEvent event, Agent &agent);
+
 protected:
   TransitionBase(const Rcpp::List &from, const Rcpp::List &to,
-                 Rcpp::Nullable<Rcpp::Function> to_change_callback,
-                 Rcpp::Nullable<Rcpp::Function> changed_callback,
+                 PCallback to_change_callback,
+                 PCallback changed_callback,
                  const std::vector<PEventLogger> &logging);
 
+  /**
+   * An event whose to_change callback is deferred to the end of a window
+   */
+  struct Deferred {
+    PEvent event;
+    PAgent agent;
+    /** the membership generation of the agent when it was deferred */
+    unsigned int membership;
+  };
+
   Rcpp::List _from;
   Rcpp::List _to;
-  std::unique_ptr<Rcpp::Function> _to_change;
-  std::unique_ptr<Rcpp::Function> _changed;
+  PCallback _to_change;
+  PCallback _changed;
   std::vector<PEventLogger> _logging;
+  BatchCallback *_batch;
+  std::vector<Deferred> _deferred;
 };
 
 /**
@@ -83,32 +137,33 @@ public:
    * @param waiting_time the waiting_time for the transition to occur,
    * an owning pointer to a WaitingTime object.
    * 
-   * @param to_change_callback the R callback function to determine if 
-   * the change should occur. See the details section.
+   * @param to_change_callback the callback to determine if the change
+   * should occur, or nullptr. See the details section.
    * 
-   * @param changed_callback the R callback function after the change
-   * happened. See the details section.
+   * @param changed_callback the callback after the change happened, or
+   * nullptr. See the details section.
    * 
    * @details the transition specifies a spontaneous state change 
    * (i.e., not caused by a contact) from the state "from" to "to".
    * The state of the agent should match "from", and the to_change_callback
-   * should be either R_NilValue or return true in order for this 
+   * should be either nullptr or return true in order for this 
    * transition to occur. 
    * 
-   * Each function takes two arguments
+   * An R callback function takes two arguments
    *   1. time: the current time in the simulation
    *   2. agent: the agent who initiate the contact, an external pointer
+   * A native callback receives the agent directly, and a nullptr contact.
    */
   Transition(const Rcpp::List &from, const Rcpp::List &to, 
              PWaitingTime waiting_time, 
-             Rcpp::Nullable<Rcpp::Function> to_change_callback=R_NilValue, 
-             Rcpp::Nullable<Rcpp::Function> changed_callback=R_NilValue,
+             PCallback to_change_callback = nullptr, 
+             PCallback changed_callback = nullptr,
              const std::vector<PEventLogger> &logging = {});
 
   virtual ~Transition();
   
   /**
-   * Calls the R callback function before the state change
+   * Calls the callback before the state change
    * to determine if the state change should happen
    * 
    * @param time the simulation time
@@ -121,7 +176,7 @@ public:
   bool toChange(double time, Agent &agent);
 
   /**
-   * Calls the R callback function after the state change happended.
+   * Calls the callback after the state change happended.
    * 
    * @param time the simulation time
    * 
@@ -131,8 +186,12 @@ public:
 
   /**
    * Invoke the event loggers after a successful transition.
+   *
+   * @param count the number of agents that made the transition at once,
+   * e.g., in an aggregated population
    */
-  void log(Simulation &simulation, TransitionEvent &event, Agent &agent);
+  void log(Simulation &simulation, TransitionEvent &event, Agent &agent,
+           double count = 1);
 
   /**
    * Schedule an agent for the next spontaneous transition event
@@ -146,6 +205,13 @@ public:
    */
   virtual void schedule(double time, Agent &agent);
 
+  virtual void flush(Simulation &sim, double time);
+
+  /**
+   * The waiting-time generator of the transition
+   */
+  const PWaitingTime &waitingTime() const { return _waiting_time; }
+
   /**
    * The R classes of a Transition object
    */
@@ -184,19 +250,19 @@ public:
    * @param waiting_time a deprecated fallback waiting-time generator. New
    * contact transitions should set the rate on their Contact instead.
    * 
-   * @param to_change_callback the R callback function to determine if 
-   * the change should occur. See the details section.
+   * @param to_change_callback the callback to determine if the change
+   * should occur, or nullptr. See the details section.
    * 
-   * @param changed_callback the R callback function after the change
-   * happened. See the details section.
+   * @param changed_callback the callback after the change happened, or
+   * nullptr. See the details section.
    * 
    * @details the transition specifies state changes caused by a contact.
    * The initiating agent and contacted agent must match their respective
-   * source states, and the to_change_callback must be either R_NilValue or
+   * source states, and the to_change_callback must be either nullptr or
    * return true for the transition to occur.
    * 
-   * Unlike the callbacks for the Transition class, each function takes 
-   * three arguments
+   * Unlike the callbacks for the Transition class, an R callback function
+   * takes three arguments
    *   1. time: the current time in the simulation
    *   2. agent: the agent who initiate the contact, an external pointer
    *   3. contact: the contact agent, an external pointer
@@ -205,8 +271,8 @@ public:
      const Rcpp::List &agent_to, const Rcpp::List &contact_to,
      std::optional<std::string> contact_type,
      PWaitingTime waiting_time, 
-     Rcpp::Nullable<Rcpp::Function> to_change_callback=R_NilValue, 
-     Rcpp::Nullable<Rcpp::Function> changed_callback=R_NilValue,
+     PCallback to_change_callback = nullptr, 
+     PCallback changed_callback = nullptr,
      const std::vector<PEventLogger> &logging = {});
   
   /**
@@ -240,7 +306,7 @@ public:
   bool matches(const Contact &contact) const;
   
   /**
-   * Calls the R callback function before the state change
+   * Calls the callback before the state change
    * to determine if the state change should happen
    * 
    * @param time the simulation time
@@ -255,7 +321,7 @@ public:
   bool toChange(double time, Agent &agent, Agent &contact);
   
   /**
-   * Calls the R callback function after the state change happended.
+   * Calls the callback after the state change happended.
    * 
    * @param time the simulation time
    * 
@@ -267,8 +333,11 @@ public:
 
   /**
    * Invoke the event loggers after a successful contact transition.
+   *
+   * @param count the number of contacts that made the transition at once
    */
-  void log(Simulation &simulation, ContactEvent &event, Agent &agent);
+  void log(Simulation &simulation, ContactEvent &event, Agent &agent,
+           double count = 1);
   
   /**
    * Schedule an agent for the next contact event
@@ -281,6 +350,8 @@ public:
    * agent's population, and the agent must match agent_from.
    */
   void schedule(double time, Agent &agent, Contact &contact);
+
+  virtual void flush(Simulation &sim, double time);
   
 protected:
   /**
@@ -329,17 +400,71 @@ public:
   ContactEvent(double time, Agent &contact, Contact &source,
                ContactTransition &rule);
 
+  ~ContactEvent() override;
+
   virtual bool handle(Simulation &sim, Agent &agent);
 
   ContactTransition &rule() const { return _rule; }
   Contact &source() const { return _source; }
   Agent &contact() const { return *_contact; }
 
+  /**
+   * Whether the contact still exists and has not left its population since
+   * this event was created, and the agent, the contact and the contact
+   * pattern are in the same population
+   */
+  bool current(const Agent &agent) const;
+
+  /**
+   * Register this pending event with its contact, so that it is found when
+   * the contact leaves its population or is destroyed
+   *
+   * @param agent the agent that this event is scheduled to
+   */
+  void attach(Agent &agent);
+
+  /**
+   * Remove this event from the dependents of its contact
+   */
+  void detach();
+
+  /**
+   * Called when the contact is destroyed, so that this event is discarded
+   */
+  void orphan();
+
+  /**
+   * Unschedule this pending event, which would be discarded when handled
+   */
+  void cancel();
+
 protected:
   ContactTransition &_rule;
   Contact &_source;
+  /** the contact, or nullptr if it has been destroyed */
   Agent *_contact;
-  std::weak_ptr<XPLease> _contact_lease;
+  /** the membership generation of the contact when this event was created */
+  unsigned int _membership;
+  /** the agent that this event is scheduled to, if attached */
+  Agent *_agent;
+  /** the position in the dependents of the contact, or NONE */
+  size_t _dependency;
+
+  static const size_t NONE = static_cast<size_t>(-1);
+};
+
+/**
+ * An event that evaluates the deferred events of a batched transition rule
+ * at the end of its time window.
+ */
+class BatchEvent : public Event {
+public:
+  BatchEvent(double time, TransitionBase &rule);
+
+  virtual bool handle(Simulation &sim, Agent &agent);
+
+protected:
+  TransitionBase &_rule;
 };
 
 /**
@@ -366,12 +491,22 @@ public:
    * of state transition (which is time + waitingTime(time)). 
    */
   virtual double waitingTime(double time);
+
+  /**
+   * the rate of the exponential distribution
+   */
+  double rate() const { return _rate; }
   
 protected:
   /** 
    * the batched exponential random number generator
    */
   RExp _exp;
+
+  /**
+   * the rate of the exponential distribution
+   */
+  double _rate;
 };
 
 /**
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "Pool.h"
 #include <Rcpp.h>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 /**
  * Capabilities supported by objects exposed through external pointers.
@@ -20,7 +22,8 @@ enum XPTag : std::uint32_t {
   XP_CONTACT      = 1u << 5,
   XP_LOGGER       = 1u << 6,
   XP_EVENT_LOGGER = 1u << 7,
-  XP_WAITING_TIME = 1u << 8
+  XP_WAITING_TIME = 1u << 8,
+  XP_CALLBACK     = 1u << 9
 };
 
 /**
@@ -33,17 +36,67 @@ class XPLease {
 
 typedef std::shared_ptr<XPLease> PXPLease;
 
+/**
+ * The scope of a call into R, e.g., a callback or an event handler. The
+ * handles borrowed for a scope are valid until it closes. Scopes nest, and
+ * each is numbered uniquely, so that opening and closing a scope allocates
+ * nothing, unlike a lease. R runs on a single thread, so the open scopes
+ * are kept in one stack.
+ */
+class XPScope {
+public:
+  XPScope() : _id(++_last) { _open.push_back(_id); }
+  ~XPScope() { _open.pop_back(); }
+
+  XPScope(const XPScope &) = delete;
+  XPScope &operator=(const XPScope &) = delete;
+
+  std::uint64_t id() const { return _id; }
+
+  /** whether the scope with the given number is still open */
+  static bool isOpen(std::uint64_t id)
+  {
+    for (auto i = _open.rbegin(); i != _open.rend(); ++i)
+      if (*i == id) return true;
+    return false;
+  }
+
+private:
+  std::uint64_t _id;
+  inline static std::uint64_t _last = 0;
+  inline static std::vector<std::uint64_t> _open;
+};
+
+/**
+ * Whether every object whose capability tag includes T::TAG is a T, i.e.,
+ * T defines its own capability bit, so that a handle can be cast to T
+ * statically. Such classes specialize this trait after their definitions.
+ */
+template<class T>
+struct XPExactTag : std::false_type {};
+
 template<class T>
 class OwnedPointer;
 
 /**
  * Common intrusive ownership state for objects exposed to R.
+ *
+ * The objects are allocated from the pools (see Pool.h), so that the many
+ * small objects of a simulation, i.e., agents, calendars and events, are
+ * packed in slabs.
  */
 class RefCountedObject {
 public:
   RefCountedObject(const RefCountedObject &) = delete;
   RefCountedObject &operator=(const RefCountedObject &) = delete;
 
+  static void *operator new(std::size_t size) { return Pool::allocate(size); }
+
+  static void operator delete(void *p, std::size_t size)
+  {
+    Pool::release(p, size);
+  }
+
 protected:
   RefCountedObject() = default;
   virtual ~RefCountedObject() = default;
@@ -240,6 +293,49 @@ private:
   std::weak_ptr<XPLease> _lease;
 };
 
+/**
+ * External-pointer storage that borrows an object for a scope. The storage
+ * can be rearmed for a later scope, so that a cached handle is reused.
+ */
+template<class T>
+class ScopedPointer final : public Pointer<T> {
+public:
+  ScopedPointer(T &pointer, const XPScope &scope)
+    : _pointer(&pointer), _scope(scope.id())
+  {
+  }
+
+  T *checked() const override
+  {
+    if (_pointer == nullptr || !XPScope::isOpen(_scope))
+      Rcpp::stop("ABM borrowed handle has expired");
+    return _pointer;
+  }
+
+  OwnedPointer<T> owned() const override { return nullptr; }
+
+  /**
+   * Borrow the object again for another scope. If the handle is still
+   * borrowed by an enclosing scope, it stays valid for that scope, which
+   * outlives the new one.
+   */
+  void rearm(const XPScope &scope)
+  {
+    if (!XPScope::isOpen(_scope))
+      _scope = scope.id();
+  }
+
+  /** expire the handle permanently, e.g., when the object is destroyed */
+  void invalidate() { _pointer = nullptr; }
+
+private:
+  T *_pointer;
+  std::uint64_t _scope;
+};
+
+template<class T>
+class XPHandle;
+
 /**
  * An external pointer to an ABM object.
  *
@@ -277,15 +373,29 @@ private:
     return XPtrBase::checked_get();
   }
 
+  /**
+   * Cast the stored object to T. The tag has been validated, so the cast
+   * is static if the tag identifies T.
+   */
+  static T *cast(PointerBase *base)
+  {
+    if constexpr (XPExactTag<T>::value)
+      return static_cast<T*>(base);
+    else {
+      T *p = dynamic_cast<T*>(base);
+      if (p == nullptr)
+        Rcpp::stop("ABM external pointer has an incompatible C++ type");
+      return p;
+    }
+  }
+
   T *checked() const
   {
-    PointerBase *base = holder()->checked();
-    T *p = dynamic_cast<T*>(base);
-    if (p == nullptr)
-      Rcpp::stop("ABM external pointer has an incompatible C++ type");
-    return p;
+    return cast(holder()->checked());
   }
 
+  friend class XPHandle<T>;
+
 public:
   explicit XP(SEXP p)
     : XPtrBase(p)
@@ -317,6 +427,18 @@ public:
     this->attr("class") = p.classes;
   }
 
+  XP(T &p, const XPScope &scope)
+    : XPtrBase(
+        new ScopedPointer<PointerBase>(
+          static_cast<PointerBase&>(p), scope),
+        true,
+        makeTag())
+  {
+    static_assert(std::is_base_of<PointerBase, T>::value,
+                  "T must derive from T::PointerBase");
+    this->attr("class") = p.classes;
+  }
+
   operator const T*() const { return checked(); }
   operator T*() { return checked(); }
 
@@ -325,10 +447,7 @@ public:
     OwnedPointer<PointerBase> base = holder()->owned();
     if (!base)
       return nullptr;
-    T *pointer = dynamic_cast<T*>(base.get());
-    if (!pointer)
-      Rcpp::stop("ABM external pointer has an incompatible C++ type");
-    return OwnedPointer<T>(pointer);
+    return OwnedPointer<T>(cast(base.get()));
   }
 
   T &operator*() { return *checked(); }
@@ -337,3 +456,51 @@ public:
   T *operator->() { return checked(); }
   const T *operator->() const { return checked(); }
 };
+
+/**
+ * A handle of an object that is borrowed by R for one scope after another,
+ * e.g., an agent passed to the callbacks. The external pointer is created
+ * on first use, and is rearmed for each later scope, so that passing the
+ * object to R allocates nothing. A handle kept by R beyond its scope is
+ * expired until the object is borrowed again, and for good once the
+ * object is destroyed.
+ */
+template<class T>
+class XPHandle {
+public:
+  XPHandle() : _holder(nullptr) {}
+
+  ~XPHandle() { reset(); }
+
+  XPHandle(const XPHandle &) = delete;
+  XPHandle &operator=(const XPHandle &) = delete;
+
+  /** the handle of the object, valid for the given scope */
+  SEXP borrow(T &object, const XPScope &scope)
+  {
+    if (_holder == nullptr) {
+      XP<T> handle(object, scope);
+      _holder = static_cast<ScopedPointer<typename T::PointerBase>*>(
+        handle.holder());
+      _handle = handle;
+    } else _holder->rearm(scope);
+    return _handle;
+  }
+
+  /** expire the handle, and let R collect it */
+  void reset()
+  {
+    if (_holder == nullptr) return;
+    _holder->invalidate();
+    _handle = R_NilValue;
+    _holder = nullptr;
+  }
+
+private:
+  /**
+   * the external pointer, protected by Rcpp, which releases it in constant
+   * time, unlike R_ReleaseObject(), which searches the preserved objects
+   */
+  Rcpp::RObject _handle;
+  ScopedPointer<typename T::PointerBase> *_holder;
+};
@@ -8,20 +8,78 @@ class DeathEvent : public Event {
 public:
   DeathEvent(double time) : Event(time) { }
   virtual bool handle(Simulation & sim, Agent &agent) {
+    Profile::record(Profile::DEATH_EVENT);
     agent.leave();
     return false;
   }
 };
 
+/**
+ * The calendar of the contact events of an agent. It is released by the
+ * agent when its last event is handled.
+ */
+class ContactCalendar : public Calendar {
+public:
+  virtual bool handle(Simulation &sim, Agent &agent) {
+    Calendar::handle(sim, agent);
+    if (size() > 0)
+      return true;
+    agent.releaseContactEvents();
+    return false;
+  }
+};
+
 Agent::Agent(Nullable<List> state)
-  : Calendar(), _population(nullptr), _id(0), _index(0),
-    _contactEvents(makeOwned<Calendar>())
+  : Calendar(), _population(nullptr), _id(0), _index(0), _membership(0)
 {
   if (state.isNotNull()) _state &= List(state);
-  schedule(_contactEvents);
 }
 
-Agent::~Agent() = default;
+Agent::Agent(const State &state)
+  : Calendar(), _population(nullptr), _id(0), _index(0), _membership(0),
+    _state(state)
+{
+}
+
+Calendar &Agent::contactEvents()
+{
+  if (!_contactEvents) {
+    _contactEvents = makeOwned<ContactCalendar>();
+    schedule(_contactEvents);
+  }
+  return *_contactEvents;
+}
+
+void Agent::clearContactEvents()
+{
+  if (!_contactEvents) return;
+  _contactEvents->clearEvents();
+  releaseContactEvents();
+}
+
+void Agent::releaseContactEvents()
+{
+  if (!_contactEvents || _contactEvents->size() > 0) return;
+  unschedule(_contactEvents);
+  _contactEvents.reset();
+}
+
+void Agent::cancelDependents()
+{
+  // cancelling an event removes it from the dependents
+  std::vector<PEvent> dependents;
+  dependents.reserve(_dependents.size());
+  for (auto event : _dependents)
+    dependents.push_back(PEvent(event));
+  for (auto &event : dependents)
+    static_cast<ContactEvent&>(*event).cancel();
+}
+
+Agent::~Agent()
+{
+  while (!_dependents.empty())
+    _dependents.back()->orphan();
+}
 
 bool Agent::handle(Simulation &sim, Agent &agent)
 {
@@ -62,15 +120,21 @@ void Agent::stateChanged(Agent &agent, const State &from)
     _population->stateChanged(agent, from);
 }
 
+State Agent::vacate()
+{
+  State save = _state;
+  stateChanging(*this, State());
+  _state = SharedState();
+  stateChanged(*this);
+  return save;
+}
+
 PAgent Agent::leave()
 {
   Population *owner = _population;
   if (owner == nullptr)
     stop("agent is not attached to a population");
-  State save = _state;
-  stateChanging(*this, State());
-  _state = State();
-  stateChanged(*this);
+  State save = vacate();
   if (_population != owner) {
     _state = save;
     stop("agent changed populations while leaving");
@@ -105,6 +169,13 @@ const PXPLease &Agent::lifetimeLease() const
   return *_lifetime_lease;
 }
 
+SEXP Agent::borrow(const XPScope &scope)
+{
+  if (!_handle)
+    _handle = std::make_unique<XPHandle<Agent> >();
+  return _handle->borrow(*this, scope);
+}
+
 void Agent::setID(Simulation &sim)
 {
   if (_id == 0)
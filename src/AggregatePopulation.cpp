@@ -0,0 +1,564 @@
+#include "../inst/include/AggregatePopulation.h"
+#include "../inst/include/Simulation.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace Rcpp;
+
+SumTree::SumTree()
+  : _size(0), _capacity(1), _tree(2, 0.0)
+{
+}
+
+void SumTree::push_back(double weight)
+{
+  if (_size == _capacity) {
+    // double the capacity, and rebuild the internal nodes
+    std::vector<double> tree(4 * _capacity, 0.0);
+    std::copy(_tree.begin() + _capacity, _tree.begin() + _capacity + _size,
+              tree.begin() + 2 * _capacity);
+    _capacity *= 2;
+    _tree.swap(tree);
+    for (size_t i = _capacity - 1; i > 0; --i)
+      _tree[i] = _tree[2 * i] + _tree[2 * i + 1];
+  }
+  set(_size++, weight);
+}
+
+void SumTree::set(size_t i, double weight)
+{
+  i += _capacity;
+  _tree[i] = weight;
+  for (i /= 2; i > 0; i /= 2)
+    _tree[i] = _tree[2 * i] + _tree[2 * i + 1];
+}
+
+size_t SumTree::find(double u) const
+{
+  size_t i = 1;
+  while (i < _capacity) {
+    i *= 2;
+    if (u >= _tree[i]) {
+      u -= _tree[i];
+      ++i;
+    }
+  }
+  i -= _capacity;
+  // rounding may select an element past the end, or one with no weight
+  if (i >= _size) i = _size - 1;
+  while (i > 0 && get(i) <= 0) --i;
+  return i;
+}
+
+void SumTree::clear()
+{
+  _size = 0;
+  _capacity = 1;
+  _tree.assign(2, 0.0);
+}
+
+/**
+ * The event of the next reaction in an aggregated population
+ */
+class ReactionEvent : public Event {
+public:
+  ReactionEvent(double time, AggregatePopulation &population)
+    : Event(time), _population(population)
+  {
+  }
+
+  virtual bool handle(Simulation &sim, Agent &agent)
+  {
+    Profile::record(Profile::REACTION_EVENT);
+    _population.react(sim, time());
+    return false;
+  }
+
+private:
+  AggregatePopulation &_population;
+};
+
+const size_t AggregatePopulation::NONE = static_cast<size_t>(-1);
+
+AggregatePopulation::AggregatePopulation(
+    List states, NumericVector counts, PContact contact)
+  : Population(), _individuals(0), _epsilon(0),
+    _agent(makeOwned<Agent>()), _contact(makeOwned<Agent>())
+{
+  if (states.size() != counts.size())
+    stop("states and counts must have the same length");
+  for (R_xlen_t i = 0; i < states.size(); ++i) {
+    double n = counts[i];
+    if (!(n >= 0) || n != std::floor(n) || std::isinf(n))
+      stop("counts must be non-negative integers");
+    SEXP state = states[i];
+    if (!Rf_isNewList(state) && state != R_NilValue)
+      state = List(state);
+    State s(Rf_duplicate(state));
+    size_t c = compartment(s);
+    _compartments[c].count += n;
+    _individuals += n;
+  }
+  if (contact) {
+    if (dynamic_cast<RandomMixing*>(contact.get()) == nullptr)
+      stop("an aggregate population requires a random mixing contact");
+    add(contact);
+  }
+  // the agents standing for individuals belong to this population, so that
+  // the event loggers can borrow them
+  _agent->_population = this;
+  _contact->_population = this;
+}
+
+AggregatePopulation::~AggregatePopulation()
+{
+  if (_next) unschedule(_next);
+  _agent->_population = nullptr;
+  _contact->_population = nullptr;
+}
+
+size_t AggregatePopulation::compartment(const State &state)
+{
+  for (size_t i = 0; i < _compartments.size(); ++i)
+    if (R_compute_identical(_compartments[i].state, state, 16))
+      return i;
+  _compartments.push_back(Compartment{state, 0, {}});
+  size_t c = _compartments.size() - 1;
+  addChannels(c);
+  return c;
+}
+
+size_t AggregatePopulation::destination(
+    std::vector<size_t> &cache, size_t c, const List &to)
+{
+  if (cache.size() <= c)
+    cache.resize(_compartments.size(), NONE);
+  if (cache[c] == NONE) {
+    const State &state = _compartments[c].state;
+    size_t d = state.match(to) ? c : compartment(state & to);
+    cache[c] = d;
+  }
+  return cache[c];
+}
+
+void AggregatePopulation::addChannels(size_t c)
+{
+  for (size_t r = 0; r < _rules.size(); ++r) {
+    const State state = _compartments[c].state;
+    Rule &rule = _rules[r];
+    if (rule.transition != nullptr) {
+      if (state.match(rule.transition->from()))
+        addChannel(r, c, NONE);
+      continue;
+    }
+    const List &from = rule.contact->from();
+    const List &contact_from = rule.contact->contactFrom();
+    bool agent_matches = state.match(from);
+    bool contact_matches = state.match(contact_from);
+    for (size_t d = 0; d < c; ++d) {
+      const State other = _compartments[d].state;
+      if (agent_matches && other.match(contact_from))
+        addChannel(r, c, d);
+      if (contact_matches && other.match(from))
+        addChannel(r, d, c);
+    }
+    if (agent_matches && contact_matches)
+      addChannel(r, c, c);
+  }
+}
+
+void AggregatePopulation::addChannel(size_t rule, size_t from, size_t contact)
+{
+  size_t i = _channels.size();
+  _channels.push_back(Channel{rule, from, contact});
+  _compartments[from].channels.push_back(i);
+  if (contact != NONE) {
+    if (contact != from)
+      _compartments[contact].channels.push_back(i);
+    _contact_channels.push_back(i);
+  }
+  _propensities.push_back(propensity(_channels[i]));
+}
+
+void AggregatePopulation::check(Rule &rule)
+{
+  if (rule.checked) return;
+  TransitionBase *base = rule.transition != nullptr ?
+    static_cast<TransitionBase*>(rule.transition) : rule.contact;
+  if (base->hasCallbacks())
+    stop("a transition with callbacks cannot be aggregated");
+  const PWaitingTime &waiting_time = rule.transition != nullptr ?
+    rule.transition->waitingTime() : rule.source->rate();
+  auto exp = dynamic_cast<ExpWaitingTime*>(waiting_time.get());
+  if (exp == nullptr)
+    stop("only exponentially distributed waiting times can be aggregated");
+  if (rule.contact != nullptr &&
+      dynamic_cast<RandomMixing*>(rule.source) == nullptr)
+    stop("only random mixing contacts can be aggregated");
+  rule.rate = exp->rate();
+  rule.checked = true;
+}
+
+double AggregatePopulation::propensity(const Channel &channel)
+{
+  Rule &rule = _rules[channel.rule];
+  double n = _compartments[channel.from].count;
+  if (!(n > 0)) return 0;
+  // a rule of ordinary agents may match a compartment that never fires
+  if (channel.contact == NONE) {
+    check(rule);
+    return rule.rate * n;
+  }
+  // each individual contacts a random other individual
+  if (_individuals <= 1) return 0;
+  double m = _compartments[channel.contact].count;
+  if (channel.contact == channel.from) --m;
+  if (m <= 0) return 0;
+  check(rule);
+  return rule.rate * n * m / (_individuals - 1);
+}
+
+void AggregatePopulation::update(size_t c)
+{
+  for (auto i : _compartments[c].channels)
+    _propensities.set(i, propensity(_channels[i]));
+}
+
+void AggregatePopulation::updateContacts()
+{
+  for (auto i : _contact_channels)
+    _propensities.set(i, propensity(_channels[i]));
+}
+
+void AggregatePopulation::move(size_t from, size_t to, double k)
+{
+  if (from == to) return;
+  _compartments[from].count -= k;
+  _compartments[to].count += k;
+}
+
+void AggregatePopulation::destinations(
+    const Channel &channel, size_t &to, size_t &contact_to)
+{
+  Rule &rule = _rules[channel.rule];
+  if (rule.transition != nullptr) {
+    to = destination(rule.to, channel.from, rule.transition->to());
+    contact_to = NONE;
+  } else {
+    to = destination(rule.to, channel.from, rule.contact->to());
+    contact_to = destination(
+      rule.contact_to, channel.contact, rule.contact->contactTo());
+  }
+}
+
+AggregatePopulation::Stoichiometry AggregatePopulation::stoichiometry(
+    const Channel &channel)
+{
+  Stoichiometry s;
+  s.size = 0;
+  s.second_order = channel.contact != NONE;
+  auto add = [&s](size_t c, double change) {
+    for (size_t i = 0; i < s.size; ++i) {
+      if (s.compartment[i] == c) {
+        s.change[i] += change;
+        return;
+      }
+    }
+    s.compartment[s.size] = c;
+    s.change[s.size++] = change;
+  };
+  size_t to, contact_to;
+  destinations(channel, to, contact_to);
+  if (to != channel.from) {
+    add(channel.from, -1);
+    add(to, 1);
+  }
+  if (contact_to != NONE && contact_to != channel.contact) {
+    add(channel.contact, -1);
+    add(contact_to, 1);
+  }
+  return s;
+}
+
+double AggregatePopulation::leap()
+{
+  double total = _propensities.total();
+  double threshold = 10 / total;
+  // the stoichiometries may add compartments and channels, whose
+  // propensities are 0
+  size_t m = _channels.size();
+  std::vector<size_t> active;
+  std::vector<Stoichiometry> changes;
+  for (size_t j = 0; j < m; ++j) {
+    if (_propensities.get(j) <= 0) continue;
+    Channel channel = _channels[j];
+    active.push_back(j);
+    changes.push_back(stoichiometry(channel));
+  }
+  // the expected change and variance of each count per unit time
+  size_t n = _compartments.size();
+  std::vector<double> mu(n, 0), sigma2(n, 0), order(n, 1);
+  for (size_t i = 0; i < active.size(); ++i) {
+    double a = _propensities.get(active[i]);
+    const Stoichiometry &s = changes[i];
+    for (size_t k = 0; k < s.size; ++k) {
+      size_t c = s.compartment[k];
+      mu[c] += s.change[k] * a;
+      sigma2[c] += s.change[k] * s.change[k] * a;
+      if (s.change[k] < 0 && s.second_order) order[c] = 2;
+    }
+  }
+  double tau = std::numeric_limits<double>::infinity();
+  for (size_t c = 0; c < n; ++c) {
+    double bound = std::max(_epsilon * _compartments[c].count / order[c], 1.0);
+    if (mu[c] != 0)
+      tau = std::min(tau, bound / std::fabs(mu[c]));
+    if (sigma2[c] != 0)
+      tau = std::min(tau, bound * bound / sigma2[c]);
+  }
+  // draw the firings, halving the leap while a count would become negative
+  std::vector<double> consumed(n);
+  while (tau >= threshold) {
+    _firings.clear();
+    std::fill(consumed.begin(), consumed.end(), 0);
+    for (size_t i = 0; i < active.size(); ++i) {
+      double k = R::rpois(_propensities.get(active[i]) * tau);
+      if (k <= 0) continue;
+      _firings.push_back(std::make_pair(active[i], k));
+      const Stoichiometry &s = changes[i];
+      for (size_t j = 0; j < s.size; ++j)
+        if (s.change[j] < 0)
+          consumed[s.compartment[j]] -= s.change[j] * k;
+    }
+    bool feasible = true;
+    for (size_t c = 0; c < n && feasible; ++c)
+      feasible = consumed[c] <= _compartments[c].count;
+    if (feasible) return tau;
+    tau /= 2;
+  }
+  _firings.clear();
+  return 0;
+}
+
+void AggregatePopulation::fire(
+    Simulation &sim, const Channel &channel, double k)
+{
+  Rule &rule = _rules[channel.rule];
+  size_t from = channel.from, contact = channel.contact;
+  size_t to, contact_to;
+  destinations(channel, to, contact_to);
+  if (rule.transition != nullptr) {
+    move(from, to, k);
+    update(from);
+    update(to);
+    log(sim, *_agent, from, to, k);
+    rule.transition->log(
+      sim, static_cast<TransitionEvent&>(*rule.event), *_agent, k);
+    return;
+  }
+  move(from, to, k);
+  move(contact, contact_to, k);
+  for (auto c : {from, to, contact, contact_to})
+    update(c);
+  _contact->_state = _compartments[contact].state;
+  if (to != from)
+    log(sim, *_agent, from, to, k);
+  else _agent->_state = _compartments[from].state;
+  if (contact_to != contact)
+    log(sim, *_contact, contact, contact_to, k);
+  rule.contact->log(
+    sim, static_cast<ContactEvent&>(*rule.event), *_agent, k);
+}
+
+void AggregatePopulation::log(
+    Simulation &sim, Agent &proxy, size_t from, size_t to, double count)
+{
+  proxy._state = _compartments[to].state;
+  sim.log(proxy, _compartments[from].state, count);
+}
+
+void AggregatePopulation::reschedule(double time)
+{
+  if (_next) {
+    unschedule(_next);
+    _next = nullptr;
+  }
+  _firings.clear();
+  double total = _propensities.total();
+  if (!(total > 0)) return;
+  double wait = _epsilon > 0 ? leap() : 0;
+  if (wait == 0)
+    wait = -std::log(1 - _unif.get()) / total;
+  _next = makeOwned<ReactionEvent>(time + wait, *this);
+  schedule(_next);
+}
+
+void AggregatePopulation::report()
+{
+  Population::report();
+  Simulation *sim = simulation();
+  if (sim == nullptr || std::isnan(sim->currentTime()))
+    return;
+  _rules.clear();
+  _channels.clear();
+  _contact_channels.clear();
+  _propensities.clear();
+  for (auto &c : _compartments)
+    c.channels.clear();
+  double time = sim->currentTime();
+  for (auto rule : sim->transitions()) {
+    PEvent event = makeOwned<TransitionEvent>(time, *rule);
+    _rules.push_back(Rule{rule, nullptr, nullptr, 0, false, {}, {}, event});
+  }
+  for (auto rule : sim->contactTransitions()) {
+    // the contact transitions of other contact patterns do not apply
+    for (const auto &contact : _contacts) {
+      if (rule->matches(*contact)) {
+        PEvent event = makeOwned<ContactEvent>(
+          time, *_contact, *contact, *rule);
+        _rules.push_back(
+          Rule{nullptr, rule, contact.get(), 0, false, {}, {}, event});
+        break;
+      }
+    }
+  }
+  for (size_t c = 0; c < _compartments.size(); ++c)
+    addChannels(c);
+  // report the individuals of each compartment at once, as agents whose
+  // state is set
+  State empty;
+  for (const auto &c : _compartments) {
+    if (!(c.count > 0)) continue;
+    _agent->_state = c.state;
+    sim->log(*_agent, empty, c.count);
+  }
+  reschedule(sim->currentTime());
+}
+
+void AggregatePopulation::react(Simulation &sim, double time)
+{
+  _next = nullptr;
+  if (!_firings.empty()) {
+    // the firings of a leap, which were drawn when it was scheduled
+    std::vector<std::pair<size_t, double> > firings;
+    firings.swap(_firings);
+    for (const auto &f : firings) {
+      Channel channel = _channels[f.first];
+      fire(sim, channel, f.second);
+    }
+  } else {
+    double total = _propensities.total();
+    if (!(total > 0)) return;
+    Channel channel = _channels[_propensities.find(_unif.get() * total)];
+    fire(sim, channel, 1);
+  }
+  reschedule(time);
+}
+
+void AggregatePopulation::setTauLeaping(double epsilon)
+{
+  if (!(epsilon >= 0) || epsilon >= 1)
+    stop("epsilon must be in [0, 1)");
+  _epsilon = epsilon;
+  Simulation *sim = simulation();
+  if (sim != nullptr && !std::isnan(sim->currentTime()) && !_rules.empty())
+    reschedule(sim->currentTime());
+}
+
+List AggregatePopulation::compartments() const
+{
+  size_t n = _compartments.size();
+  List states(n);
+  NumericVector counts(n);
+  for (size_t i = 0; i < n; ++i) {
+    states[i] = _compartments[i].state;
+    counts[i] = _compartments[i].count;
+  }
+  return List::create(Named("state") = states, Named("count") = counts);
+}
+
+std::vector<PAgent> AggregatePopulation::materialize(
+    const List &rule, size_t k)
+{
+  std::vector<size_t> matched;
+  double n = 0;
+  for (size_t c = 0; c < _compartments.size(); ++c) {
+    if (_compartments[c].state.match(rule)) {
+      matched.push_back(c);
+      n += _compartments[c].count;
+    }
+  }
+  if (k > n) k = n;
+  Simulation *sim = simulation();
+  std::vector<PAgent> agents;
+  agents.reserve(k);
+  for (size_t i = 0; i < k; ++i) {
+    // the individuals are drawn one by one, without replacement
+    double u = _unif.get() * n;
+    size_t c = matched.back();
+    for (auto m : matched) {
+      if (u < _compartments[m].count) {
+        c = m;
+        break;
+      }
+      u -= _compartments[m].count;
+    }
+    Compartment &compartment = _compartments[c];
+    if (compartment.count <= 0) continue;
+    compartment.count -= 1;
+    n -= 1;
+    _individuals -= 1;
+    agents.push_back(makeOwned<Agent>(State(Rf_duplicate(compartment.state))));
+    if (sim != nullptr) {
+      _agent->_state = SharedState();
+      sim->log(*_agent, compartment.state);
+    }
+  }
+  for (auto c : matched)
+    update(c);
+  updateContacts();
+  if (sim != nullptr && !std::isnan(sim->currentTime()))
+    reschedule(sim->currentTime());
+  return agents;
+}
+
+CharacterVector AggregatePopulation::classes = CharacterVector::create(
+  "AggregatePopulation", "Population", "Agent", "Event");
+
+// [[Rcpp::export]]
+XP<AggregatePopulation> newAggregatePopulation(
+    List states, NumericVector counts, SEXP contact = R_NilValue)
+{
+  PContact c;
+  if (contact != R_NilValue)
+    c = XP<Contact>(contact);
+  return XP<AggregatePopulation>(
+    makeOwned<AggregatePopulation>(states, counts, c));
+}
+
+// [[Rcpp::export]]
+List getCompartments(XP<AggregatePopulation> population)
+{
+  return population->compartments();
+}
+
+// [[Rcpp::export]]
+void setTauLeaping(XP<AggregatePopulation> population, double epsilon)
+{
+  population->setTauLeaping(epsilon);
+}
+
+// [[Rcpp::export]]
+List materializeAgents(XP<AggregatePopulation> aggregate, List rule, int k,
+                       XP<Population> population)
+{
+  if (k < 0)
+    stop("k must not be negative");
+  std::vector<PAgent> agents = aggregate->materialize(rule, k);
+  population->add(agents);
+  List result(agents.size());
+  for (size_t i = 0; i < agents.size(); ++i)
+    result[i] = XP<Agent>(agents[i]);
+  return result;
+}
@@ -0,0 +1,211 @@
+#include "../inst/include/Simulation.h"
+#include "../inst/include/Expression.h"
+
+using namespace Rcpp;
+
+Callback::~Callback()
+{
+}
+
+void Callback::changed(double time, Agent &agent, Agent *contact)
+{
+  toChange(time, agent, contact);
+}
+
+CharacterVector Callback::classes = CharacterVector::create("Callback");
+
+RCallback::RCallback(Function f)
+  : _f(f)
+{
+}
+
+SEXP RCallback::call(double time, Agent &agent, Agent *contact)
+{
+  Profile::Timer timer(Profile::R_CALLBACK);
+  XPScope scope;
+  if (contact == nullptr)
+    return _f(NumericVector::create(time), agent.borrow(scope));
+  return _f(
+    NumericVector::create(time),
+    agent.borrow(scope),
+    contact->borrow(scope));
+}
+
+bool RCallback::toChange(double time, Agent &agent, Agent *contact)
+{
+  RObject result = call(time, agent, contact);
+  return as<bool>(result);
+}
+
+void RCallback::changed(double time, Agent &agent, Agent *contact)
+{
+  call(time, agent, contact);
+}
+
+NativeCallback::NativeCallback(NativeCallbackFunction f, SEXP data)
+  : _f(f), _data(data), _address(nullptr)
+{
+  if (f == nullptr)
+    stop("native callback function is NULL");
+  if (data != R_NilValue) {
+    if (TYPEOF(data) != EXTPTRSXP)
+      stop("native callback data must be an external pointer or NULL");
+    _address = R_ExternalPtrAddr(data);
+  }
+}
+
+bool NativeCallback::toChange(double time, Agent &agent, Agent *contact)
+{
+  return _f(time, agent, contact, _address);
+}
+
+ProbabilityCallback::ProbabilityCallback(double p)
+  : _p(p)
+{
+  if (!(p >= 0 && p <= 1))
+    stop("probability must be between 0 and 1");
+}
+
+bool ProbabilityCallback::toChange(double time, Agent &agent, Agent *contact)
+{
+  return _unif.get() < _p;
+}
+
+TimestampCallback::TimestampCallback(const std::string &name)
+  : _update(1)
+{
+  if (name.empty())
+    stop("the state domain name must not be empty");
+  CharacterVector names(1);
+  SET_STRING_ELT(names, 0, State::symbol(name));
+  _update.attr("names") = names;
+}
+
+bool TimestampCallback::toChange(double time, Agent &agent, Agent *contact)
+{
+  return true;
+}
+
+void TimestampCallback::changed(double time, Agent &agent, Agent *contact)
+{
+  SET_VECTOR_ELT(_update, 0, Rf_ScalarReal(time));
+  agent.set(_update);
+}
+
+BatchCallback::BatchCallback(Function f, double window, bool states)
+  : _f(f), _window(window), _states(states)
+{
+  if (!(window > 0 && window < R_PosInf))
+    stop("the time window must be a positive number");
+}
+
+List BatchCallback::arguments(
+    const std::vector<Agent*> &agents, const XPScope &scope) const
+{
+  size_t n = agents.size();
+  List result(n);
+  for (size_t i = 0; i < n; ++i) {
+    if (_states)
+      result[i] = agents[i]->state();
+    else result[i] = agents[i]->borrow(scope);
+  }
+  return result;
+}
+
+std::vector<bool> BatchCallback::evaluate(
+    const std::vector<double> &time, const std::vector<Agent*> &agents,
+    const std::vector<Agent*> &contacts)
+{
+  Profile::Timer timer(Profile::R_CALLBACK);
+  size_t n = time.size();
+  XPScope scope;
+  NumericVector t(time.begin(), time.end());
+  SEXP r;
+  if (contacts.empty())
+    r = _f(t, arguments(agents, scope));
+  else r = _f(t, arguments(agents, scope), arguments(contacts, scope));
+  LogicalVector result(r);
+  if (static_cast<size_t>(result.size()) != n)
+    stop("a batch callback must return a logical vector with one element "
+         "for each event");
+  std::vector<bool> change(n);
+  for (size_t i = 0; i < n; ++i)
+    change[i] = result[i] == TRUE;
+  return change;
+}
+
+bool BatchCallback::toChange(double time, Agent &agent, Agent *contact)
+{
+  std::vector<Agent*> contacts;
+  if (contact != nullptr)
+    contacts.push_back(contact);
+  return evaluate({time}, {&agent}, contacts)[0];
+}
+
+PCallback parseCallback(SEXP value, const std::string &argument)
+{
+  if (value == R_NilValue)
+    return nullptr;
+  if (Rf_inherits(value, "formula"))
+    return makeOwned<ExpressionCallback>(value);
+  if (Rf_isFunction(value))
+    return makeOwned<RCallback>(as<Function>(value));
+  if (TYPEOF(value) == EXTPTRSXP && Rf_inherits(value, "Callback"))
+    return XP<Callback>(value);
+  stop(argument + " must be a function or NULL, or a formula or a Callback "
+       "object");
+}
+
+static bool matchAgentStateCallable(const Agent &agent, SEXP rule)
+{
+  return agent.match(List(rule));
+}
+
+static void setAgentStateCallable(Agent &agent, SEXP state)
+{
+  agent.set(List(state));
+}
+
+// [[Rcpp::init]]
+void registerNativeCallables(DllInfo *dll)
+{
+  R_RegisterCCallable("ABM", "matchAgentState",
+    castFunction<DL_FUNC>(matchAgentStateCallable));
+  R_RegisterCCallable("ABM", "setAgentState",
+    castFunction<DL_FUNC>(setAgentStateCallable));
+}
+
+// [[Rcpp::export]]
+XP<Callback> newNativeCallback(SEXP callback, SEXP data = R_NilValue)
+{
+  DL_FUNC f = nullptr;
+  if (TYPEOF(callback) == EXTPTRSXP) {
+    if (R_ExternalPtrTag(callback) != Rf_install("NativeCallbackFunction"))
+      stop("callback must be created by makeNativeCallbackPointer()");
+    f = R_ExternalPtrAddrFn(callback);
+  } else if (TYPEOF(callback) == STRSXP && Rf_xlength(callback) == 2) {
+    f = R_GetCCallable(
+      CHAR(STRING_ELT(callback, 0)), CHAR(STRING_ELT(callback, 1)));
+  } else
+    stop("callback must be an external pointer or a package and a name");
+  return XP<Callback>(makeOwned<NativeCallback>(
+    castFunction<NativeCallbackFunction>(f), data));
+}
+
+// [[Rcpp::export]]
+XP<Callback> newProbabilityCallback(double p)
+{
+  return XP<Callback>(makeOwned<ProbabilityCallback>(p));
+}
+
+// [[Rcpp::export]]
+XP<Callback> newTimestampCallback(std::string name)
+{
+  return XP<Callback>(makeOwned<TimestampCallback>(name));
+}
+
+// [[Rcpp::export]]
+XP<Callback> newBatchCallback(Function f, double window, bool states = false)
+{
+  return XP<Callback>(makeOwned<BatchCallback>(f, window, states));
+}
@@ -49,6 +49,12 @@ void Contact::attach(Population &population)
   build();
 }
 
+void Contact::add(const std::vector<Agent*> &agents)
+{
+  for (auto agent : agents)
+    add(*agent);
+}
+
 void Contact::detach(Population &population)
 {
   if (_population == &population)
@@ -82,6 +88,10 @@ void RandomMixing::add(Agent &agent)
 {
 }
 
+void RandomMixing::add(const std::vector<Agent*> &agents)
+{
+}
+
 void RandomMixing::remove(Agent &agent)
 {
 }
@@ -113,6 +123,7 @@ Function RContact::callback(const char *name) const
 
 const std::vector<Agent*> &RContact::contact(double time, Agent &agent)
 {
+  Profile::Timer timer(Profile::R_CALLBACK);
   Function contact = callback("contact");
   GenericVector c = contact(time, XP<Agent>(agent, agent.membershipLease()));
   size_t n = c.size();
@@ -126,18 +137,21 @@ const std::vector<Agent*> &RContact::contact(double time, Agent &agent)
 
 void RContact::add(Agent &agent)
 {
+  Profile::Timer timer(Profile::R_CALLBACK);
   Function addAgent = callback("addAgent");
   addAgent(XP<Agent>(agent, agent.membershipLease()));
 }
 
 void RContact::build()
 {
+  Profile::Timer timer(Profile::R_CALLBACK);
   Function attach = callback("attach");
   attach(XP<Population>(*_population, _population->lifetimeLease()));
 }
 
 void RContact::remove(Agent &agent)
 {
+  Profile::Timer timer(Profile::R_CALLBACK);
   Function remove = callback("remove");
   remove(XP<Agent>(agent, agent.membershipLease()));
 }
@@ -1,4 +1,6 @@
 #include "../inst/include/Counter.h"
+#include <algorithm>
+#include <cmath>
 
 using namespace Rcpp;
 
@@ -11,6 +13,12 @@ Logger::~Logger()
 {
 }
 
+void Logger::log(const Agent &agent, const State &from_state, double count)
+{
+  for (double i = 0; i < count; ++i)
+    log(agent, from_state);
+}
+
 bool Logger::stateChanging(const Agent &agent, const List &state)
 {
   return false;
@@ -20,6 +28,38 @@ void Logger::stateChanged(const Agent &agent)
 {
 }
 
+bool Logger::watches(std::vector<SEXP> &domains) const
+{
+  return false;
+}
+
+size_t Logger::cells() const
+{
+  return 0;
+}
+
+void Logger::reportCells(double *values)
+{
+}
+
+List Logger::tabulate(const NumericVector &times, const double *values) const
+{
+  return List();
+}
+
+bool Logger::temporal() const
+{
+  return false;
+}
+
+void Logger::begin(double time)
+{
+}
+
+void Logger::observe(double time)
+{
+}
+
 Counter::Counter(const std::string &name, const List &state, Nullable<List> to, long initial)
   : Logger(name), _count(initial), _from_match(false), _state(state), _to(to)
 {
@@ -27,15 +67,21 @@ Counter::Counter(const std::string &name, const List &state, Nullable<List> to,
 
 void Counter::log(const Agent &agent, const State &from_state)
 {
+  log(agent, from_state, 1);
+}
+
+void Counter::log(const Agent &agent, const State &from_state, double count)
+{
+  long n = static_cast<long>(count);
   if (_to.isNull()) {
     if (from_state.match(_state)) {
-      --_count;
+      _count -= n;
     }
     if (agent.match(_state)) {
-      ++_count;
+      _count += n;
     }
   } else if (agent.match(List(_to)) && from_state.match(_state))
-    ++_count;
+    _count += n;
 }
 
 bool Counter::stateChanging(const Agent &agent, const List &state)
@@ -58,6 +104,21 @@ void Counter::stateChanged(const Agent &agent)
   _from_match = false;
 }
 
+bool Counter::watches(std::vector<SEXP> &domains) const
+{
+  // a transition counter may count a change that sets none of its domains
+  if (!_to.isNull()) return false;
+  SEXP ns = _state.names();
+  if (ns == R_NilValue || XLENGTH(ns) == 0) return false;
+  R_xlen_t n = XLENGTH(ns);
+  for (R_xlen_t i = 0; i < n; ++i)
+    if (STRING_ELT(ns, i) == NA_STRING || CHAR(STRING_ELT(ns, i))[0] == 0)
+      return false;
+  for (R_xlen_t i = 0; i < n; ++i)
+    domains.push_back(STRING_ELT(ns, i));
+  return true;
+}
+
 double Counter::report()
 {
   long x = _count;
@@ -65,6 +126,11 @@ double Counter::report()
   return x;
 }
 
+double Counter::value()
+{
+  return _count;
+}
+
 StateLogger::StateLogger(const std::string &name, PAgent agent, const std::string &state)
   : Logger(name), _value(R_NaN), _agent(agent.get()),
     _agent_lease(agent ? agent->lifetimeLease() : PXPLease()), _state(state)
@@ -77,6 +143,12 @@ void StateLogger::log(const Agent &agent, const State &from_state)
   _value = as<double>(a.state()[_state]);
 }
 
+void StateLogger::log(
+    const Agent &agent, const State &from_state, double count)
+{
+  if (count > 0) log(agent, from_state);
+}
+
 bool StateLogger::stateChanging(const Agent &agent, const List &state)
 {
   return !_agent || _agent_lease.expired();
@@ -89,12 +161,316 @@ void StateLogger::stateChanged(const Agent &agent)
 }
 
 double StateLogger::report()
+{
+  return value();
+}
+
+double StateLogger::value()
 {
   if (_agent && !_agent_lease.expired())
     return as<double>(_agent->state()[_state]);
   return _value;
 }
 
+CrossTab::CrossTab(const std::string &name, const List &levels)
+  : Logger(name), _levels(levels), _total(0), _from_cell(-1)
+{
+  SEXP ns = levels.names();
+  R_xlen_t n = levels.size();
+  if (n == 0 || ns == R_NilValue)
+    stop("the levels must be a named list");
+  size_t k = 1;
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SEXP domain = STRING_ELT(ns, i);
+    if (domain == NA_STRING || CHAR(domain)[0] == 0)
+      stop("the levels must be a named list");
+    for (R_xlen_t j = 0; j < i; ++j)
+      if (State::same(domain, STRING_ELT(ns, j)))
+        stop("duplicated domain: ", CHAR(domain));
+    SEXP l = VECTOR_ELT(levels, i);
+    if ((TYPEOF(l) != STRSXP && TYPEOF(l) != REALSXP && TYPEOF(l) != INTSXP)
+        || Rf_isFactor(l) || XLENGTH(l) == 0)
+      stop("the levels of ", CHAR(domain),
+           " must be a non-empty character or numeric vector");
+    _strides.push_back(k);
+    k *= XLENGTH(l);
+  }
+  _counts.assign(k, 0);
+}
+
+/**
+ * The position of a scalar value in the levels, or -1 if it is not a level
+ */
+static long level(SEXP value, SEXP levels)
+{
+  if (Rf_length(value) != 1) return -1;
+  R_xlen_t n = XLENGTH(levels);
+  if (TYPEOF(levels) == STRSXP) {
+    if (TYPEOF(value) != STRSXP) return -1;
+    SEXP x = STRING_ELT(value, 0);
+    for (R_xlen_t i = 0; i < n; ++i)
+      if (State::same(x, STRING_ELT(levels, i))) return i;
+    return -1;
+  }
+  double x;
+  if (TYPEOF(value) == REALSXP) x = REAL(value)[0];
+  else if (TYPEOF(value) == INTSXP && INTEGER(value)[0] != NA_INTEGER)
+    x = INTEGER(value)[0];
+  else return -1;
+  for (R_xlen_t i = 0; i < n; ++i) {
+    double l = TYPEOF(levels) == REALSXP ? REAL(levels)[i] : INTEGER(levels)[i];
+    if (x == l) return i;
+  }
+  return -1;
+}
+
+long CrossTab::cell(const State &state) const
+{
+  SEXP ns = _levels.names();
+  long c = 0;
+  for (size_t i = 0; i < _strides.size(); ++i) {
+    R_xlen_t position = state.find(STRING_ELT(ns, i));
+    if (position < 0) return -1;
+    long l = level(VECTOR_ELT(state, position), VECTOR_ELT(_levels, i));
+    if (l < 0) return -1;
+    c += l * _strides[i];
+  }
+  return c;
+}
+
+void CrossTab::log(const Agent &agent, const State &from_state)
+{
+  log(agent, from_state, 1);
+}
+
+void CrossTab::log(const Agent &agent, const State &from_state, double count)
+{
+  long from = cell(from_state);
+  if (from >= 0) {
+    _counts[from] -= count;
+    _total -= count;
+  }
+  long to = cell(agent.state());
+  if (to >= 0) {
+    _counts[to] += count;
+    _total += count;
+  }
+}
+
+bool CrossTab::stateChanging(const Agent &agent, const List &state)
+{
+  _from_cell = cell(agent.state());
+  return true;
+}
+
+void CrossTab::stateChanged(const Agent &agent)
+{
+  if (_from_cell >= 0) {
+    --_counts[_from_cell];
+    --_total;
+  }
+  long to = cell(agent.state());
+  if (to >= 0) {
+    ++_counts[to];
+    ++_total;
+  }
+  _from_cell = -1;
+}
+
+bool CrossTab::watches(std::vector<SEXP> &domains) const
+{
+  SEXP ns = _levels.names();
+  for (R_xlen_t i = 0; i < XLENGTH(ns); ++i)
+    domains.push_back(STRING_ELT(ns, i));
+  return true;
+}
+
+double CrossTab::report()
+{
+  return _total;
+}
+
+double CrossTab::value()
+{
+  return _total;
+}
+
+void CrossTab::reportCells(double *values)
+{
+  std::copy(_counts.begin(), _counts.end(), values);
+}
+
+List CrossTab::tabulate(const NumericVector &times, const double *values) const
+{
+  R_xlen_t n = times.size(), k = _counts.size(), rows = n * k;
+  SEXP ns = _levels.names();
+  size_t m = _strides.size();
+  List columns(m + 2);
+  CharacterVector names(m + 2);
+  NumericVector t(rows), count(rows);
+  for (R_xlen_t i = 0; i < rows; ++i) {
+    t[i] = times[i / k];
+    count[i] = values[i];
+  }
+  columns[0] = t;
+  names[0] = "times";
+  for (size_t j = 0; j < m; ++j) {
+    SEXP levels = VECTOR_ELT(_levels, j);
+    R_xlen_t size = XLENGTH(levels);
+    RObject column(Rf_allocVector(TYPEOF(levels), rows));
+    for (R_xlen_t i = 0; i < rows; ++i) {
+      R_xlen_t l = (i % k) / _strides[j] % size;
+      switch (TYPEOF(levels)) {
+      case STRSXP:
+        SET_STRING_ELT(column, i, STRING_ELT(levels, l));
+        break;
+      case REALSXP:
+        REAL(column)[i] = REAL(levels)[l];
+        break;
+      default:
+        INTEGER(column)[i] = INTEGER(levels)[l];
+      }
+    }
+    columns[j + 1] = column;
+    names[j + 1] = STRING_ELT(ns, j);
+  }
+  columns[m + 1] = count;
+  names[m + 1] = "count";
+  columns.attr("names") = names;
+  columns.attr("row.names") = IntegerVector::create(NA_INTEGER, -static_cast<int>(rows));
+  columns.attr("class") = "data.frame";
+  return columns;
+}
+
+EventTable::EventTable(const std::string &name, const List &levels)
+  : CrossTab(name, levels)
+{
+}
+
+void EventTable::log(const Agent &agent, const State &from_state)
+{
+}
+
+void EventTable::log(
+    const Agent &agent, const State &from_state, double count)
+{
+}
+
+bool EventTable::stateChanging(const Agent &agent, const List &state)
+{
+  return false;
+}
+
+void EventTable::stateChanged(const Agent &agent)
+{
+}
+
+bool EventTable::watches(std::vector<SEXP> &domains) const
+{
+  return true;
+}
+
+bool EventTable::change(const State &state, double delta)
+{
+  long c = cell(state);
+  if (c < 0) return false;
+  _counts[c] += delta;
+  _total += delta;
+  return true;
+}
+
+bool EventTable::conforms(const EventTable &table) const
+{
+  return R_compute_identical(_levels, table._levels, 16);
+}
+
+TemporalLogger::TemporalLogger(const std::string &name, PLogger source,
+                               Statistic statistic, double threshold)
+  : Logger(name), _source(source), _statistic(statistic),
+    _threshold(threshold), _time(R_NaN), _value(R_NaN), _integral(0),
+    _max(R_NaN), _min(R_NaN), _rising(true), _passage(NA_REAL)
+{
+  if (statistic == PASSAGE && std::isnan(threshold))
+    stop("a first passage time needs a threshold");
+}
+
+TemporalLogger::Statistic TemporalLogger::statistic(const std::string &name)
+{
+  if (name == "integral") return INTEGRAL;
+  if (name == "max") return MAXIMUM;
+  if (name == "min") return MINIMUM;
+  if (name == "passage") return PASSAGE;
+  stop("invalid statistic ", name);
+}
+
+void TemporalLogger::log(const Agent &agent, const State &from_state)
+{
+}
+
+void TemporalLogger::log(
+    const Agent &agent, const State &from_state, double count)
+{
+}
+
+bool TemporalLogger::watches(std::vector<SEXP> &domains) const
+{
+  return true;
+}
+
+bool TemporalLogger::temporal() const
+{
+  return true;
+}
+
+void TemporalLogger::begin(double time)
+{
+  _time = time;
+  _value = _source->value();
+  _integral = 0;
+  _max = _min = _value;
+  _rising = _value < _threshold;
+  _passage = (_value == _threshold) ? time : NA_REAL;
+}
+
+void TemporalLogger::observe(double time)
+{
+  if (std::isnan(_time)) {
+    begin(time);
+    return;
+  }
+  if (time < _time) time = _time;
+  _integral += _value * (time - _time);
+  _time = time;
+  _value = _source->value();
+  if (_value > _max) _max = _value;
+  if (_value < _min) _min = _value;
+  if (std::isnan(_passage) &&
+      (_rising ? _value >= _threshold : _value <= _threshold))
+    _passage = time;
+}
+
+double TemporalLogger::report()
+{
+  double x = value();
+  _integral = 0;
+  _max = _min = _value;
+  return x;
+}
+
+double TemporalLogger::value()
+{
+  switch (_statistic) {
+  case INTEGRAL:
+    return _integral;
+  case MAXIMUM:
+    return _max;
+  case MINIMUM:
+    return _min;
+  default:
+    return _passage;
+  }
+}
+
 // [[Rcpp::export]]
 XP<Counter> newCounter(std::string name, List from, Nullable<List> to=R_NilValue, int initial=0)
 {
@@ -110,5 +486,14 @@ XP<StateLogger> newStateLogger(std::string name, Nullable<XP<Agent> > agent, std
   return XP<StateLogger>(makeOwned<StateLogger>(name, pa, state));
 }
 
+// [[Rcpp::export]]
+XP<CrossTab> newCrossTab(std::string name, List levels)
+{
+  return XP<CrossTab>(makeOwned<CrossTab>(name, levels));
+}
+
 Rcpp::CharacterVector Counter::classes = CharacterVector::create("Counter", "Logger");
 Rcpp::CharacterVector StateLogger::classes = CharacterVector::create("StateLogger", "Logger");
+Rcpp::CharacterVector CrossTab::classes = CharacterVector::create("CrossTab", "Logger");
+Rcpp::CharacterVector EventTable::classes = CharacterVector::create("EventTable", "CrossTab", "Logger");
+Rcpp::CharacterVector TemporalLogger::classes = CharacterVector::create("TemporalLogger", "Logger");
@@ -1,4 +1,5 @@
 #include "../inst/include/Simulation.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace Rcpp;
@@ -19,9 +20,10 @@ REvent::REvent(double time, Function handler)
 
 bool REvent::handle(Simulation &sim, Agent &agent)
 {
-  PXPLease lease = std::make_shared<XPLease>();
-  _handler(
-    wrap(time()), XP<Simulation>(sim, lease), XP<Agent>(agent, lease));
+  Profile::record(Profile::R_EVENT);
+  Profile::Timer timer(Profile::R_CALLBACK);
+  XPScope scope;
+  _handler(wrap(time()), sim.borrowSimulation(scope), agent.borrow(scope));
   return false;
 }
 
@@ -64,6 +66,8 @@ bool Calendar::handle(Simulation &sim, Agent &agent)
 
 void Calendar::schedule(PEvent event)
 {
+  Profile::Cascade cascade;
+  Profile::record(Profile::SCHEDULE);
   if (event->_owner != nullptr)
     event->_owner->unschedule(event);
   double t = event->time();
@@ -72,6 +76,7 @@ void Calendar::schedule(PEvent event)
   Calendar *owner = update ? _owner : nullptr;
   PEvent me;
   if (owner != nullptr) {
+    Profile::record(Profile::CASCADE);
     me = _pos->second;
     owner->unschedule(me);
   }
@@ -81,12 +86,50 @@ void Calendar::schedule(PEvent event)
     owner->schedule(me);
 }
 
+void Calendar::schedule(std::vector<PEvent> events)
+{
+  if (events.empty()) return;
+  Profile::Cascade cascade;
+  if (Profile::current() != nullptr)
+    Profile::current()->count(Profile::SCHEDULE, events.size());
+  for (auto &event : events)
+    if (event->_owner != nullptr)
+      event->_owner->unschedule(event);
+  std::stable_sort(events.begin(), events.end(),
+    [](const PEvent &x, const PEvent &y) { return x->time() < y->time(); });
+  double t = events.front()->time();
+  bool update = _time > t;
+  if (update) _time = t;
+  Calendar *owner = update ? _owner : nullptr;
+  PEvent me;
+  if (owner != nullptr) {
+    Profile::record(Profile::CASCADE);
+    me = _pos->second;
+    owner->unschedule(me);
+  }
+  // insert each event before the first later event, which is found by a
+  // search only when the time passes it
+  auto next = _events.upper_bound(t);
+  for (auto &event : events) {
+    double time = event->time();
+    if (next != _events.end() && next->first <= time)
+      next = _events.upper_bound(time);
+    event->_owner = this;
+    event->_pos = _events.emplace_hint(next, time, event);
+  }
+  if (owner != nullptr)
+    owner->schedule(me);
+}
+
 void Calendar::unschedule(PEvent event)
 {
   if (event == NULL || event->_owner != this) return;
+  Profile::Cascade cascade;
+  Profile::record(Profile::UNSCHEDULE);
   Calendar *owner = (_time == event->time()) ? _owner : nullptr;
   PEvent me;
   if (owner != nullptr) {
+    Profile::record(Profile::CASCADE);
     me = _pos->second;
     owner->unschedule(me);
   }
@@ -97,6 +140,38 @@ void Calendar::unschedule(PEvent event)
     owner->schedule(me);
 }
 
+void Calendar::unschedule(const std::vector<PEvent> &events)
+{
+  Profile::Cascade cascade;
+  // the calendar is rescheduled in its owner only if its earliest event is
+  // removed
+  bool update = false;
+  size_t n = 0;
+  for (const auto &event : events) {
+    if (event == NULL || event->_owner != this) continue;
+    ++n;
+    if (event->time() == _time) update = true;
+  }
+  if (n == 0) return;
+  if (Profile::current() != nullptr)
+    Profile::current()->count(Profile::UNSCHEDULE, n);
+  Calendar *owner = update ? _owner : nullptr;
+  PEvent me;
+  if (owner != nullptr) {
+    Profile::record(Profile::CASCADE);
+    me = _pos->second;
+    owner->unschedule(me);
+  }
+  for (const auto &event : events) {
+    if (event == NULL || event->_owner != this) continue;
+    _events.erase(event->_pos);
+    event->_owner = nullptr;
+  }
+  _time = _events.empty() ? R_PosInf : _events.begin()->first;
+  if (owner != nullptr)
+    owner->schedule(me);
+}
+
 void Calendar::clearEvents()
 {
   Calendar *owner = !std::isinf(_time) ? _owner : nullptr;
@@ -6,41 +6,126 @@ EventLogger::~EventLogger()
 {
 }
 
+void EventLogger::log(
+    Simulation &simulation, Agent &agent, TransitionEvent &event,
+    double count)
+{
+  for (double i = 0; i < count; ++i)
+    log(simulation, agent, event);
+}
+
+void EventLogger::log(
+    Simulation &simulation, Agent &agent, ContactEvent &event, double count)
+{
+  for (double i = 0; i < count; ++i)
+    log(simulation, agent, event);
+}
+
+void EventLogger::attach(Simulation &simulation)
+{
+}
+
 StateEventLogger::StateEventLogger(
     const std::string &variable,
     double change,
-    Nullable<Function> filter)
-  : _variable(variable), _change(change), _filter(filter)
+    SEXP filter)
+  : _variable(variable), _symbol(1), _change(change)
 {
+  if (TYPEOF(filter) == VECSXP)
+    _rule = filter;
+  else if (Rf_isFunction(filter))
+    _filter = filter;
+  else if (filter != R_NilValue)
+    stop("the filter must be a rule (a list) or a function");
+  SET_STRING_ELT(_symbol, 0, State::symbol(variable));
 }
 
 bool StateEventLogger::matches(const Agent &agent) const
 {
-  if (_filter.isNull()) return true;
+  if (_rule.size() > 0)
+    return agent.match(_rule);
+  if (_filter == R_NilValue) return true;
+  Profile::Timer timer(Profile::R_CALLBACK);
   Function filter(_filter);
   return as<bool>(filter(agent.state()));
 }
 
-void StateEventLogger::apply(Simulation &simulation, Agent &agent)
+void StateEventLogger::apply(
+    Simulation &simulation, Agent &agent, double count)
 {
-  if (matches(agent)) simulation.change(_variable, _change);
+  if (matches(agent))
+    simulation.change(STRING_ELT(_symbol, 0), _change * count);
 }
 
 void StateEventLogger::log(
     Simulation &simulation, Agent &agent, TransitionEvent &event)
 {
-  apply(simulation, agent);
+  apply(simulation, agent, 1);
 }
 
 void StateEventLogger::log(
     Simulation &simulation, Agent &agent, ContactEvent &event)
 {
-  apply(simulation, agent);
+  apply(simulation, agent, 1);
+}
+
+void StateEventLogger::log(
+    Simulation &simulation, Agent &agent, TransitionEvent &event,
+    double count)
+{
+  apply(simulation, agent, count);
+}
+
+void StateEventLogger::log(
+    Simulation &simulation, Agent &agent, ContactEvent &event, double count)
+{
+  apply(simulation, agent, count);
+}
+
+GroupedEventLogger::GroupedEventLogger(
+    const std::string &name,
+    double change,
+    const List &levels,
+    SEXP filter)
+  : StateEventLogger(name, change, filter),
+    _table(makeOwned<EventTable>(name, levels))
+{
+}
+
+GroupedEventLogger::~GroupedEventLogger()
+{
+}
+
+void GroupedEventLogger::attach(Simulation &simulation)
+{
+  PLogger logger = simulation.logger(_variable);
+  if (!logger) {
+    simulation.add(PLogger(_table));
+    return;
+  }
+  EventTable *table = dynamic_cast<EventTable*>(logger.get());
+  if (table == nullptr || !table->conforms(*_table))
+    stop("the simulation has a different logger named ", _variable);
+  _table = OwnedPointer<EventTable>(table);
+}
+
+void GroupedEventLogger::apply(
+    Simulation &simulation, Agent &agent, double count)
+{
+  if (matches(agent)) _table->change(agent.state(), _change * count);
+}
+
+// [[Rcpp::export]]
+XP<EventLogger> newGroupedEventLogger(
+    std::string name, double change, List levels, SEXP filter = R_NilValue)
+{
+  return XP<EventLogger>(
+      makeOwned<GroupedEventLogger>(name, change, levels, filter));
 }
 
 // [[Rcpp::export]]
 XP<EventLogger> newIncrementLogger(
-    std::string variable, Nullable<Function> filter = R_NilValue)
+    std::string variable, SEXP filter = R_NilValue)
 {
   return XP<EventLogger>(
       makeOwned<StateEventLogger>(variable, 1, filter));
@@ -48,7 +133,7 @@ XP<EventLogger> newIncrementLogger(
 
 // [[Rcpp::export]]
 XP<EventLogger> newDecrementLogger(
-    std::string variable, Nullable<Function> filter = R_NilValue)
+    std::string variable, SEXP filter = R_NilValue)
 {
   return XP<EventLogger>(
       makeOwned<StateEventLogger>(variable, -1, filter));
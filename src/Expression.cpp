@@ -0,0 +1,702 @@
+#include "../inst/include/Simulation.h"
+#include "../inst/include/Expression.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+using namespace Rcpp;
+
+static double absolute(double x) { return std::fabs(x); }
+static double exponential(double x) { return std::exp(x); }
+static double logarithm(double x) { return std::log(x); }
+static double squareRoot(double x) { return std::sqrt(x); }
+static double roundDown(double x) { return std::floor(x); }
+static double roundUp(double x) { return std::ceil(x); }
+static double roundEven(double x) { return std::nearbyint(x); }
+
+typedef double (*Math)(double);
+
+static const char *math_names[] = {
+  "abs", "exp", "log", "sqrt", "floor", "ceiling", "round"
+};
+
+static const Math math_functions[] = {
+  absolute, exponential, logarithm, squareRoot, roundDown, roundUp, roundEven
+};
+
+Expression::Expression(SEXP expr, SEXP env)
+  : _env(env), _has_effects(false)
+{
+  compile(expr);
+  _stack.reserve(16);
+}
+
+SEXP Expression::lookup(SEXP symbol) const
+{
+  SEXP value = Rf_findVar(symbol, _env);
+  if (TYPEOF(value) == PROMSXP)
+    value = Rf_eval(value, _env);
+  return value;
+}
+
+Expression::Value Expression::asValue(SEXP x)
+{
+  Value v;
+  v.type = Value::NUMBER;
+  v.number = NA_REAL;
+  v.string = NA_STRING;
+  if (x == R_NilValue || Rf_xlength(x) == 0) return v;
+  switch (TYPEOF(x)) {
+  case REALSXP:
+    v.number = REAL(x)[0];
+    break;
+  case INTSXP: {
+    int i = INTEGER(x)[0];
+    v.number = i == NA_INTEGER ? NA_REAL : i;
+    break;
+  }
+  case LGLSXP: {
+    int l = LOGICAL(x)[0];
+    v.type = Value::LOGICAL;
+    v.number = l == NA_LOGICAL ? NA_REAL : l;
+    break;
+  }
+  case STRSXP:
+    v.type = Value::STRING;
+    v.string = STRING_ELT(x, 0);
+    break;
+  default:
+    stop("values used in an expression must be numeric, logical or character");
+  }
+  return v;
+}
+
+SEXP Expression::asSEXP(const Value &value)
+{
+  switch (value.type) {
+  case Value::LOGICAL:
+    return Rf_ScalarLogical(
+      ISNAN(value.number) ? NA_LOGICAL : value.number != 0);
+  case Value::STRING:
+    return Rf_ScalarString(value.string);
+  default:
+    return Rf_ScalarReal(value.number);
+  }
+}
+
+Expression::Value Expression::number(double value)
+{
+  return Value{Value::NUMBER, value, NA_STRING};
+}
+
+Expression::Value Expression::logical(bool value, bool na)
+{
+  return Value{Value::LOGICAL, na ? NA_REAL : (value ? 1.0 : 0.0), NA_STRING};
+}
+
+double Expression::asNumber(const Value &value)
+{
+  if (value.type == Value::STRING)
+    stop("non-numeric argument in an expression");
+  return value.number;
+}
+
+bool Expression::truth(const Value &value, bool &na)
+{
+  if (value.type == Value::STRING)
+    stop("a character value cannot be used as a condition in an expression");
+  na = ISNAN(value.number);
+  return !na && value.number != 0;
+}
+
+int Expression::constant(const Value &value)
+{
+  _constants.push_back(value);
+  return _constants.size() - 1;
+}
+
+int Expression::constant(SEXP value, const std::string &name)
+{
+  int type = TYPEOF(value);
+  if ((type != REALSXP && type != INTSXP && type != LGLSXP &&
+       type != STRSXP) || Rf_xlength(value) != 1)
+    stop(name + " must be a numeric, logical or character scalar; "
+         "use " + name + "[i] for a lookup table");
+  _protected.push_back(RObject(value));
+  return constant(asValue(value));
+}
+
+int Expression::field(SEXP name, bool contact)
+{
+  for (size_t i = 0; i < _fields.size(); ++i)
+    if (_fields[i].contact == contact && State::same(_fields[i].name, name))
+      return i;
+  _protected.push_back(RObject(name));
+  _fields.push_back(Field{name, contact, -1});
+  return _fields.size() - 1;
+}
+
+int Expression::table(SEXP symbol)
+{
+  if (TYPEOF(symbol) != SYMSXP)
+    stop("only a variable can be indexed in an expression");
+  std::string name = CHAR(PRINTNAME(symbol));
+  SEXP values = lookup(symbol);
+  int type = TYPEOF(values);
+  if (values == R_UnboundValue)
+    stop("lookup table " + name + " is not defined");
+  if (type != REALSXP && type != INTSXP && type != LGLSXP && type != STRSXP)
+    stop("lookup table " + name +
+         " must be a numeric, logical or character vector");
+  for (size_t i = 0; i < _tables.size(); ++i)
+    if (static_cast<SEXP>(_tables[i].values) == values)
+      return i;
+  Table t;
+  t.values = values;
+  SEXP names = Rf_getAttrib(values, R_NamesSymbol);
+  if (names != R_NilValue) {
+    R_xlen_t n = Rf_xlength(names);
+    for (R_xlen_t i = 0; i < n; ++i)
+      t.positions.emplace(STRING_ELT(names, i), i);
+  }
+  _tables.push_back(t);
+  return _tables.size() - 1;
+}
+
+static SEXP fieldName(SEXP x)
+{
+  if (TYPEOF(x) == SYMSXP)
+    return PRINTNAME(x);
+  if (TYPEOF(x) == STRSXP && Rf_xlength(x) == 1)
+    return STRING_ELT(x, 0);
+  stop("invalid state domain name in an expression");
+}
+
+/** the variable x of .env$x or !!x, or R_NilValue */
+static SEXP variable(const std::string &f, SEXP args)
+{
+  static SEXP env = Rf_install(".env"), bang = Rf_install("!");
+  if (f == "$" && Rf_length(args) == 2 && CAR(args) == env) {
+    SEXP x = CADR(args);
+    return TYPEOF(x) == STRSXP && Rf_xlength(x) == 1 ?
+      Rf_installChar(STRING_ELT(x, 0)) : x;
+  }
+  if (f == "!" && Rf_length(args) == 1) {
+    SEXP inner = CAR(args);
+    if (TYPEOF(inner) == LANGSXP && CAR(inner) == bang &&
+        Rf_length(CDR(inner)) == 1 && TYPEOF(CADR(inner)) == SYMSXP)
+      return CADR(inner);
+  }
+  return R_NilValue;
+}
+
+static bool isContact(SEXP object)
+{
+  if (TYPEOF(object) == SYMSXP) {
+    std::string name = CHAR(PRINTNAME(object));
+    if (name == "state") return false;
+    if (name == "contact") return true;
+  }
+  stop("only state$name and contact$name can be accessed in an expression");
+}
+
+void Expression::compile(SEXP expr)
+{
+  switch (TYPEOF(expr)) {
+  case REALSXP:
+  case INTSXP:
+  case LGLSXP:
+  case STRSXP:
+    emit(CONST, constant(expr, "a constant"));
+    return;
+  case SYMSXP: {
+    std::string name = CHAR(PRINTNAME(expr));
+    if (name == "time") {
+      emit(TIME);
+      return;
+    }
+    emit(LOAD, field(PRINTNAME(expr), false));
+    return;
+  }
+  case LANGSXP:
+    if (TYPEOF(CAR(expr)) != SYMSXP)
+      stop("unsupported function call in an expression");
+    compileCall(CHAR(PRINTNAME(CAR(expr))), CDR(expr));
+    return;
+  default:
+    stop("unsupported expression");
+  }
+}
+
+void Expression::compileCall(const std::string &f, SEXP args)
+{
+  int n = Rf_length(args);
+  auto arity = [&f, n](int expected) {
+    if (n != expected)
+      stop("wrong number of arguments to " + f + " in an expression");
+  };
+  static const std::map<std::string, OpCode> binary = {
+    {"*", MUL}, {"/", DIV}, {"^", POW}, {"%%", MOD}, {"%/%", IDIV},
+    {"==", EQ}, {"!=", NE}, {"<", LT}, {"<=", LE}, {">", GT}, {">=", GE},
+    {"&", AND}, {"|", OR}
+  };
+  SEXP var = variable(f, args);
+  if (var != R_NilValue) {
+    if (TYPEOF(var) != SYMSXP)
+      stop("invalid variable name in an expression");
+    std::string name = CHAR(PRINTNAME(var));
+    SEXP value = lookup(var);
+    if (value == R_UnboundValue)
+      stop("variable " + name + " is not defined");
+    emit(CONST, constant(value, name));
+    return;
+  }
+  auto op = binary.find(f);
+  if (op != binary.end()) {
+    arity(2);
+    compile(CAR(args));
+    compile(CADR(args));
+    emit(op->second);
+  } else if (f == "+" || f == "-") {
+    if (n == 1) {
+      if (f == "+") emit(CONST, constant(number(0)));
+      compile(CAR(args));
+      emit(f == "+" ? ADD : NEG);
+    } else {
+      arity(2);
+      compile(CAR(args));
+      compile(CADR(args));
+      emit(f == "+" ? ADD : SUB);
+    }
+  } else if (f == "!") {
+    arity(1);
+    compile(CAR(args));
+    emit(NOT);
+  } else if (f == "&&" || f == "||") {
+    arity(2);
+    compile(CAR(args));
+    size_t jump = _code.size();
+    emit(f == "&&" ? AND_JUMP : OR_JUMP);
+    compile(CADR(args));
+    emit(f == "&&" ? AND : OR);
+    _code[jump].arg = _code.size();
+  } else if (f == "(") {
+    arity(1);
+    compile(CAR(args));
+  } else if (f == "{") {
+    if (n == 0)
+      stop("empty block in an expression");
+    for (SEXP s = args; s != R_NilValue; s = CDR(s)) {
+      compile(CAR(s));
+      if (CDR(s) != R_NilValue) emit(POP);
+    }
+  } else if (f == "$") {
+    arity(2);
+    emit(LOAD, field(fieldName(CADR(args)), isContact(CAR(args))));
+  } else if (f == "[" || f == "[[") {
+    arity(2);
+    int t = table(CAR(args));
+    compile(CADR(args));
+    emit(INDEX, t);
+  } else if (f == "<-" || f == "=") {
+    arity(2);
+    SEXP target = CAR(args);
+    int k;
+    if (TYPEOF(target) == SYMSXP) {
+      if (std::string(CHAR(PRINTNAME(target))) == "time")
+        stop("cannot assign to time in an expression");
+      k = field(PRINTNAME(target), false);
+    } else if (TYPEOF(target) == LANGSXP && CAR(target) == R_DollarSymbol) {
+      k = field(fieldName(CADDR(target)), isContact(CADR(target)));
+    } else stop("only state$name and contact$name can be assigned to in "
+                "an expression");
+    compile(CADR(args));
+    emit(STORE, k);
+    _has_effects = true;
+  } else if (f == "ifelse" || f == "if") {
+    arity(3);
+    compile(CAR(args));
+    size_t otherwise = _code.size();
+    emit(f == "if" ? JUMP_UNLESS : BRANCH);
+    compile(CADR(args));
+    size_t end = _code.size();
+    emit(JUMP);
+    _code[otherwise].arg = _code.size();
+    compile(CADDR(args));
+    _code[end].arg = _code.size();
+  } else if (f == "is.na") {
+    arity(1);
+    compile(CAR(args));
+    emit(ISNA);
+  } else if (f == "min" || f == "max") {
+    if (n == 0)
+      stop("wrong number of arguments to " + f + " in an expression");
+    compile(CAR(args));
+    for (SEXP s = CDR(args); s != R_NilValue; s = CDR(s)) {
+      compile(CAR(s));
+      emit(f == "min" ? MIN : MAX);
+    }
+  } else if (f == "runif") {
+    if (n > 3)
+      stop("wrong number of arguments to runif in an expression");
+    if (n > 0) {
+      SEXP count = CAR(args);
+      if (!Rf_isNumeric(count) || Rf_xlength(count) != 1 ||
+          Rf_asReal(count) != 1)
+        stop("runif in an expression can only generate one number");
+    }
+    if (n > 1) compile(CADR(args));
+    else emit(CONST, constant(number(0)));
+    if (n > 2) compile(CADDR(args));
+    else emit(CONST, constant(number(1)));
+    emit(RUNIF);
+  } else {
+    int count = sizeof(math_names) / sizeof(math_names[0]);
+    for (int i = 0; i < count; ++i) {
+      if (f == math_names[i]) {
+        arity(1);
+        compile(CAR(args));
+        emit(CALL1, i);
+        return;
+      }
+    }
+    stop("unsupported function " + f + " in an expression");
+  }
+}
+
+Expression::Value Expression::load(
+    int k, const Agent &agent, const Agent *contact)
+{
+  Field &f = _fields[k];
+  auto &pending = f.contact ? _contact_updates : _agent_updates;
+  for (auto i = pending.rbegin(); i != pending.rend(); ++i)
+    if (i->first == k) return i->second;
+  const Agent *a = f.contact ? contact : &agent;
+  if (a == nullptr)
+    stop("contact is not available in a spontaneous transition");
+  SEXP state = a->state();
+  SEXP names = Rf_getAttrib(state, R_NamesSymbol);
+  if (names == R_NilValue)
+    return asValue(R_NilValue);
+  R_xlen_t n = Rf_xlength(names);
+  if (f.hint < 0 || f.hint >= n ||
+      !State::same(STRING_ELT(names, f.hint), f.name)) {
+    f.hint = -1;
+    for (R_xlen_t i = 0; i < n; ++i) {
+      if (State::same(STRING_ELT(names, i), f.name)) {
+        f.hint = i;
+        break;
+      }
+    }
+    if (f.hint < 0)
+      return asValue(R_NilValue);
+  }
+  return asValue(VECTOR_ELT(state, f.hint));
+}
+
+Expression::Value Expression::index(const Table &table, const Value &i) const
+{
+  SEXP values = table.values;
+  R_xlen_t position = -1;
+  if (i.type == Value::STRING) {
+    auto p = table.positions.find(i.string);
+    if (p != table.positions.end())
+      position = p->second;
+  } else if (!ISNAN(i.number)) {
+    R_xlen_t k = static_cast<R_xlen_t>(i.number);
+    if (k >= 1 && k <= Rf_xlength(values))
+      position = k - 1;
+  }
+  Value v;
+  v.type = Value::NUMBER;
+  v.number = NA_REAL;
+  v.string = NA_STRING;
+  switch (TYPEOF(values)) {
+  case REALSXP:
+    if (position >= 0) v.number = REAL(values)[position];
+    break;
+  case INTSXP:
+    if (position >= 0 && INTEGER(values)[position] != NA_INTEGER)
+      v.number = INTEGER(values)[position];
+    break;
+  case LGLSXP:
+    v.type = Value::LOGICAL;
+    if (position >= 0 && LOGICAL(values)[position] != NA_LOGICAL)
+      v.number = LOGICAL(values)[position];
+    break;
+  case STRSXP:
+    v.type = Value::STRING;
+    if (position >= 0) v.string = STRING_ELT(values, position);
+    break;
+  }
+  return v;
+}
+
+bool Expression::isNA(const Value &value)
+{
+  return value.type == Value::STRING ?
+    value.string == NA_STRING : ISNAN(value.number);
+}
+
+Expression::Value Expression::compare(
+    OpCode op, const Value &x, const Value &y)
+{
+  // NA, e.g., a missing domain, compares as NA with a value of any type
+  if (isNA(x) || isNA(y))
+    return logical(false, true);
+  if (x.type == Value::STRING || y.type == Value::STRING) {
+    if (x.type != y.type)
+      stop("cannot compare a character value with a number in an "
+           "expression");
+    if (op != EQ && op != NE)
+      stop("character values can only be compared by == and != in an "
+           "expression");
+    return logical(State::same(x.string, y.string) == (op == EQ));
+  }
+  switch (op) {
+  case EQ: return logical(x.number == y.number);
+  case NE: return logical(x.number != y.number);
+  case LT: return logical(x.number < y.number);
+  case LE: return logical(x.number <= y.number);
+  case GT: return logical(x.number > y.number);
+  default: return logical(x.number >= y.number);
+  }
+}
+
+void Expression::execute(double time, Agent &agent, Agent *contact)
+{
+  _stack.clear();
+  _agent_updates.clear();
+  _contact_updates.clear();
+  size_t pc = 0, n = _code.size();
+  while (pc < n) {
+    const Instruction &instruction = _code[pc++];
+    switch (instruction.op) {
+    case CONST:
+      _stack.push_back(_constants[instruction.arg]);
+      break;
+    case TIME:
+      _stack.push_back(number(time));
+      break;
+    case LOAD:
+      _stack.push_back(load(instruction.arg, agent, contact));
+      break;
+    case STORE: {
+      const Field &f = _fields[instruction.arg];
+      if (f.contact && contact == nullptr)
+        stop("contact is not available in a spontaneous transition");
+      auto &pending = f.contact ? _contact_updates : _agent_updates;
+      auto i = std::find_if(pending.begin(), pending.end(),
+        [&instruction](const std::pair<int, Value> &u) {
+          return u.first == instruction.arg;
+        });
+      if (i == pending.end())
+        pending.emplace_back(instruction.arg, _stack.back());
+      else i->second = _stack.back();
+      break;
+    }
+    case INDEX: {
+      Value i = _stack.back();
+      _stack.back() = index(_tables[instruction.arg], i);
+      break;
+    }
+    case POP:
+      _stack.pop_back();
+      break;
+    case NEG:
+      _stack.back() = number(-asNumber(_stack.back()));
+      break;
+    case NOT: {
+      bool na, t = truth(_stack.back(), na);
+      _stack.back() = logical(!t, na);
+      break;
+    }
+    case ISNA:
+      _stack.back() = logical(isNA(_stack.back()));
+      break;
+    case CALL1:
+      _stack.back() = number(
+        math_functions[instruction.arg](asNumber(_stack.back())));
+      break;
+    case JUMP:
+      pc = instruction.arg;
+      break;
+    case JUMP_UNLESS: {
+      bool na, t = truth(_stack.back(), na);
+      if (na)
+        stop("missing value where TRUE/FALSE needed in an expression");
+      _stack.pop_back();
+      if (!t) pc = instruction.arg;
+      break;
+    }
+    case BRANCH: {
+      bool na, t = truth(_stack.back(), na);
+      if (na) {
+        // the value is NA, and the jump before the else branch gives the end
+        _stack.back() = logical(false, true);
+        pc = _code[instruction.arg - 1].arg;
+        break;
+      }
+      _stack.pop_back();
+      if (!t) pc = instruction.arg;
+      break;
+    }
+    case AND_JUMP: {
+      bool na, t = truth(_stack.back(), na);
+      if (!na && !t) {
+        _stack.back() = logical(false);
+        pc = instruction.arg;
+      }
+      break;
+    }
+    case OR_JUMP: {
+      bool na, t = truth(_stack.back(), na);
+      if (t) {
+        _stack.back() = logical(true);
+        pc = instruction.arg;
+      }
+      break;
+    }
+    case RUNIF: {
+      double max = asNumber(_stack.back());
+      _stack.pop_back();
+      double min = asNumber(_stack.back());
+      _stack.back() = number(min + (max - min) * _unif.get());
+      break;
+    }
+    default: {
+      Value y = _stack.back();
+      _stack.pop_back();
+      Value &x = _stack.back();
+      switch (instruction.op) {
+      case ADD:
+        x = number(asNumber(x) + asNumber(y));
+        break;
+      case SUB:
+        x = number(asNumber(x) - asNumber(y));
+        break;
+      case MUL:
+        x = number(asNumber(x) * asNumber(y));
+        break;
+      case DIV:
+        x = number(asNumber(x) / asNumber(y));
+        break;
+      case POW:
+        x = number(std::pow(asNumber(x), asNumber(y)));
+        break;
+      case MOD: {
+        double a = asNumber(x), b = asNumber(y);
+        x = number(a - std::floor(a / b) * b);
+        break;
+      }
+      case IDIV:
+        x = number(std::floor(asNumber(x) / asNumber(y)));
+        break;
+      case MIN:
+      case MAX: {
+        double a = asNumber(x), b = asNumber(y);
+        if (ISNAN(a) || ISNAN(b))
+          x = number(NA_REAL);
+        else x = number(instruction.op == MIN ? std::min(a, b) : std::max(a, b));
+        break;
+      }
+      case AND:
+      case OR: {
+        bool nx, ny;
+        bool tx = truth(x, nx), ty = truth(y, ny);
+        if (instruction.op == AND) {
+          if ((!nx && !tx) || (!ny && !ty)) x = logical(false);
+          else x = logical(true, nx || ny);
+        } else {
+          if (tx || ty) x = logical(true);
+          else x = logical(false, nx || ny);
+        }
+        break;
+      }
+      default:
+        x = compare(instruction.op, x, y);
+      }
+    }
+    }
+  }
+}
+
+List Expression::updates(std::vector<std::pair<int, Value>> &pending) const
+{
+  size_t n = pending.size();
+  List update(n);
+  CharacterVector names(n);
+  for (size_t i = 0; i < n; ++i) {
+    update[i] = asSEXP(pending[i].second);
+    SET_STRING_ELT(names, i, _fields[pending[i].first].name);
+  }
+  update.attr("names") = names;
+  pending.clear();
+  return update;
+}
+
+void Expression::apply(Agent &agent, Agent *contact)
+{
+  if (_agent_updates.empty() && _contact_updates.empty()) return;
+  List agent_update = updates(_agent_updates);
+  List contact_update = updates(_contact_updates);
+  if (agent_update.size() > 0)
+    agent.set(agent_update);
+  if (contact_update.size() > 0)
+    contact->set(contact_update);
+}
+
+bool Expression::evaluate(double time, Agent &agent, Agent *contact)
+{
+  execute(time, agent, contact);
+  bool na, result = false;
+  if (!_stack.empty() && _stack.back().type != Value::STRING)
+    result = truth(_stack.back(), na);
+  // the assignments belong to the transition, which only happens if true
+  if (result) apply(agent, contact);
+  else {
+    _agent_updates.clear();
+    _contact_updates.clear();
+  }
+  return result;
+}
+
+void Expression::run(double time, Agent &agent, Agent *contact)
+{
+  execute(time, agent, contact);
+  apply(agent, contact);
+}
+
+static SEXP formulaExpression(SEXP formula)
+{
+  if (!Rf_inherits(formula, "formula") || Rf_length(formula) != 2)
+    stop("an expression callback must be a one-sided formula");
+  return CADR(formula);
+}
+
+static SEXP formulaEnvironment(SEXP formula)
+{
+  SEXP env = Rf_getAttrib(formula, Rf_install(".Environment"));
+  return TYPEOF(env) == ENVSXP ? env : R_GlobalEnv;
+}
+
+ExpressionCallback::ExpressionCallback(SEXP formula)
+  : _expression(formulaExpression(formula), formulaEnvironment(formula))
+{
+}
+
+bool ExpressionCallback::toChange(double time, Agent &agent, Agent *contact)
+{
+  return _expression.evaluate(time, agent, contact);
+}
+
+void ExpressionCallback::changed(double time, Agent &agent, Agent *contact)
+{
+  _expression.run(time, agent, contact);
+}
+
+// [[Rcpp::export]]
+XP<Callback> newExpressionCallback(SEXP formula)
+{
+  return XP<Callback>(makeOwned<ExpressionCallback>(formula));
+}
@@ -0,0 +1,124 @@
+#include "../inst/include/Pool.h"
+
+Pool::Pool(std::size_t size)
+  : _available(nullptr), _size(size),
+    _blocks((SLAB_SIZE - blockSize(sizeof(Slab))) / size), _used(0), _capacity(0),
+    _slabs(0)
+{
+}
+
+Pool::~Pool()
+{
+  // the slabs with blocks in use are left to their objects
+  while (_available != nullptr) {
+    Slab *slab = _available;
+    remove(slab);
+    if (slab->used == 0)
+      ::operator delete(slab, std::align_val_t(SLAB_SIZE));
+  }
+}
+
+void Pool::push(Slab *slab)
+{
+  slab->previous = nullptr;
+  slab->next = _available;
+  if (_available != nullptr)
+    _available->previous = slab;
+  _available = slab;
+}
+
+void Pool::remove(Slab *slab)
+{
+  if (slab->previous != nullptr)
+    slab->previous->next = slab->next;
+  else _available = slab->next;
+  if (slab->next != nullptr)
+    slab->next->previous = slab->previous;
+  slab->previous = slab->next = nullptr;
+}
+
+void Pool::grow()
+{
+  char *memory = static_cast<char*>(
+    ::operator new(SLAB_SIZE, std::align_val_t(SLAB_SIZE)));
+  Slab *slab = reinterpret_cast<Slab*>(memory);
+  slab->used = 0;
+  slab->free = nullptr;
+  slab->fresh = memory + blockSize(sizeof(Slab));
+  slab->end = slab->fresh + _blocks * _size;
+  push(slab);
+  _capacity += _blocks;
+  ++_slabs;
+}
+
+void *Pool::allocate()
+{
+  if (_available == nullptr)
+    grow();
+  Slab *slab = _available;
+  void *block;
+  if (slab->free != nullptr) {
+    block = slab->free;
+    slab->free = slab->free->next;
+  } else {
+    // consecutive allocations from a new slab are contiguous
+    block = slab->fresh;
+    slab->fresh += _size;
+  }
+  if (slab->free == nullptr && slab->fresh == slab->end)
+    remove(slab);
+  ++slab->used;
+  ++_used;
+  return block;
+}
+
+void Pool::release(void *p)
+{
+  Slab *slab = Pool::slab(p);
+  if (slab->free == nullptr && slab->fresh == slab->end)
+    push(slab);
+  Block *block = static_cast<Block*>(p);
+  block->next = slab->free;
+  slab->free = block;
+  --slab->used;
+  --_used;
+  // an empty slab is kept as a spare if the other slabs have less than a
+  // slab of free blocks, so that allocating and releasing at the end of a
+  // slab does not allocate a slab each time
+  if (slab->used == 0 && _capacity - _used - _blocks >= _blocks) {
+    remove(slab);
+    _capacity -= _blocks;
+    --_slabs;
+    ::operator delete(slab, std::align_val_t(SLAB_SIZE));
+  }
+}
+
+Pool *Pool::of(std::size_t size)
+{
+  // the pools are never destroyed, so that objects released during static
+  // destruction remain valid
+  static const std::size_t n = MAX_SIZE / ALIGNMENT;
+  static Pool **pools = [] {
+    Pool **p = new Pool*[n];
+    for (std::size_t i = 0; i < n; ++i)
+      p[i] = new Pool((i + 1) * ALIGNMENT);
+    return p;
+  }();
+  if (size > MAX_SIZE) return nullptr;
+  return pools[size == 0 ? 0 : (size - 1) / ALIGNMENT];
+}
+
+void *Pool::allocate(std::size_t size)
+{
+  Pool *pool = of(size);
+  return pool == nullptr ? ::operator new(size) : pool->allocate();
+}
+
+void Pool::release(void *p, std::size_t size)
+{
+  if (p == nullptr) return;
+  Pool *pool = of(size);
+  if (pool == nullptr)
+    ::operator delete(p);
+  else pool->release(p);
+}
@@ -1,38 +1,171 @@
 #include "../inst/include/Population.h"
+#include "../inst/include/Simulation.h"
+#include "../inst/include/Transition.h"
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace Rcpp;
 
 Population::Population(size_t n, Nullable<Function> initializer)
   : Agent()
 {
-  _agents.reserve(n);
+  reserve(n);
+  std::vector<PAgent> agents;
+  agents.reserve(n);
   if (initializer.isNull()) {
     for (size_t i = 0; i < n; ++i)
-      addInitialAgent(R_NilValue);
+      agents.push_back(initialAgent(R_NilValue));
   } else {
     Function f(initializer);
     for (size_t i = 0; i < n; ++i) {
       SEXP state = f(i + 1);
-      addInitialAgent(state);
+      agents.push_back(initialAgent(state));
     }
   }
+  addInitialAgents(agents);
 }
 
 Population::Population(List states)
   : Agent()
 {
+  if (Rf_isFrame(states)) {
+    addInitialAgents(DataFrame(states));
+    return;
+  }
   size_t n = states.size();
-  _agents.reserve(n);
+  reserve(n);
+  std::vector<PAgent> agents;
+  agents.reserve(n);
   for (size_t i = 0; i < n; ++i)
-    addInitialAgent(states[i]);
+    agents.push_back(initialAgent(states[i]));
+  addInitialAgents(agents);
+}
+
+void Population::reserve(size_t n)
+{
+  _agents.reserve(_agents.size() + n);
 }
 
-void Population::addInitialAgent(SEXP state)
+PAgent Population::initialAgent(SEXP state)
 {
   if (!Rf_isNewList(state) && state != R_NilValue)
     state = List(state);
-  add(makeOwned<Agent>(Nullable<List>(state)));
+  return makeOwned<Agent>(Nullable<List>(state));
+}
+
+void Population::addInitialAgents(const std::vector<PAgent> &agents)
+{
+  std::vector<PEvent> events;
+  events.reserve(agents.size());
+  for (const auto &agent : agents) {
+    agent->_index = _agents.size();
+    agent->_population = this;
+    _agents.push_back(agent);
+    events.push_back(agent);
+  }
+  schedule(std::move(events));
+  for (const auto &agent : agents)
+    agent->registered(*this);
+  std::vector<Agent*> added;
+  added.reserve(agents.size());
+  for (const auto &agent : agents)
+    added.push_back(agent.get());
+  for (auto &c : _contacts)
+    c->add(added);
+}
+
+/**
+ * A column of a data frame that generates the values in the states
+ */
+class Column {
+public:
+  Column(SEXP column)
+    : _column(Rf_isFactor(column) ? Rf_asCharacterFactor(column) : column)
+  {
+    switch (TYPEOF(_column)) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case STRSXP:
+    case VECSXP:
+      break;
+    default:
+      stop("unsupported data frame column type");
+    }
+  }
+
+  /**
+   * the value of row i, a length-1 vector, or the element of a list column
+   *
+   * @details the values of a character or logical column are shared by the
+   * rows with the same value.
+   */
+  SEXP operator[](R_xlen_t i)
+  {
+    switch (TYPEOF(_column)) {
+    case LGLSXP:
+      return shared(LOGICAL(_column)[i], [](int x) {
+        return Rf_ScalarLogical(x);
+      });
+    case INTSXP:
+      return Rf_ScalarInteger(INTEGER(_column)[i]);
+    case REALSXP:
+      return Rf_ScalarReal(REAL(_column)[i]);
+    case STRSXP:
+      return shared(STRING_ELT(_column, i), [](SEXP x) {
+        return Rf_ScalarString(x);
+      });
+    default:
+      return VECTOR_ELT(_column, i);
+    }
+  }
+
+private:
+  template<class T, class F>
+  SEXP shared(T key, F create)
+  {
+    auto &values = cache(key);
+    auto v = values.find(key);
+    if (v != values.end())
+      return v->second;
+    RObject value = create(key);
+    values.emplace(key, value);
+    return value;
+  }
+
+  /** the shared values of a logical column, selected by the key type */
+  std::unordered_map<int, RObject> &cache(int) { return _logical; }
+
+  /** the shared values of a character column */
+  std::unordered_map<SEXP, RObject> &cache(SEXP) { return _string; }
+
+  RObject _column;
+  std::unordered_map<int, RObject> _logical;
+  std::unordered_map<SEXP, RObject> _string;
+};
+
+void Population::addInitialAgents(const DataFrame &data)
+{
+  R_xlen_t k = data.size();
+  R_xlen_t n = data.nrow();
+  CharacterVector names = data.names();
+  std::vector<Column> columns;
+  columns.reserve(k);
+  for (R_xlen_t j = 0; j < k; ++j)
+    columns.emplace_back(data[j]);
+  reserve(n);
+  std::vector<PAgent> agents;
+  agents.reserve(n);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    List state(k);
+    for (R_xlen_t j = 0; j < k; ++j)
+      SET_VECTOR_ELT(state, j, columns[j][i]);
+    // the column names are shared by all states
+    state.attr("names") = names;
+    agents.push_back(makeOwned<Agent>(State(state)));
+  }
+  addInitialAgents(agents);
 }
 
 Population::~Population()
@@ -41,9 +174,10 @@ Population::~Population()
     contact->detach(*this);
   for (auto &agent : _agents) {
     if (agent && agent->_population == this) {
-      agent->_contactEvents->clearEvents();
+      agent->clearContactEvents();
       unschedule(agent);
       agent->_population = nullptr;
+      ++agent->_membership;
       agent->_membership_lease.reset();
     }
   }
@@ -72,6 +206,39 @@ void Population::add(PAgent agent)
     c->add(*agent);
 }
 
+void Population::add(const std::vector<PAgent> &agents)
+{
+  for (const auto &agent : agents) {
+    Population *nested = dynamic_cast<Population*>(agent.get());
+    if (nested == nullptr) continue;
+    for (Population *owner = this; owner != nullptr;
+         owner = owner->_population) {
+      if (owner == nested)
+        stop("cannot add a population to itself or one of its descendants");
+    }
+  }
+  _agents.reserve(_agents.size() + agents.size());
+  std::vector<PEvent> events;
+  std::vector<Agent*> added;
+  events.reserve(agents.size());
+  added.reserve(agents.size());
+  for (const auto &agent : agents) {
+    if (agent->_population == this) continue;
+    if (agent->_population != nullptr)
+      agent->leave();
+    agent->_index = _agents.size();
+    _agents.push_back(agent);
+    agent->_population = this;
+    agent->registered(*this);
+    agent->report();
+    events.push_back(agent);
+    added.push_back(agent.get());
+  }
+  schedule(std::move(events));
+  for (auto c : _contacts)
+    c->add(added);
+}
+
 void Population::add(PContact contact)
 {
   for (const auto &existing : _contacts)
@@ -93,16 +260,92 @@ void Population::report()
     a->report();
 }
 
+/**
+ * The estimated size of an R object, excluding the objects that have been
+ * counted
+ */
+static size_t objectSize(SEXP x, Population::Footprint &footprint)
+{
+  if (x == R_NilValue || !footprint.counted.insert(x).second)
+    return 0;
+  ++footprint.state_objects;
+  // the header of a vector on a 64-bit platform
+  const size_t header = 48;
+  size_t n = Rf_xlength(x), size = header;
+  switch (TYPEOF(x)) {
+  case LGLSXP:
+  case INTSXP:
+    size += (n * sizeof(int) + 7) / 8 * 8;
+    break;
+  case REALSXP:
+    size += n * sizeof(double);
+    break;
+  case CHARSXP:
+    size += (n + 8) / 8 * 8;
+    break;
+  case STRSXP:
+    size += n * sizeof(SEXP);
+    for (size_t i = 0; i < n; ++i)
+      size += objectSize(STRING_ELT(x, i), footprint);
+    break;
+  case VECSXP:
+    size += n * sizeof(SEXP);
+    for (size_t i = 0; i < n; ++i)
+      size += objectSize(VECTOR_ELT(x, i), footprint);
+    break;
+  default:
+    size = 56;
+  }
+  return size + objectSize(Rf_getAttrib(x, R_NamesSymbol), footprint);
+}
+
+void Population::footprint(Footprint &footprint) const
+{
+  const size_t agent_bytes = Pool::blockSize(sizeof(Agent));
+  const size_t calendar_bytes = Pool::blockSize(sizeof(Calendar));
+  // an event and its node in a calendar
+  const size_t event_bytes = Pool::blockSize(sizeof(ContactEvent)) +
+    Pool::blockSize(sizeof(EventQueue::value_type) + 4 * sizeof(void*));
+  for (const auto &agent : _agents) {
+    const Population *population =
+      dynamic_cast<const Population*>(agent.get());
+    if (population != nullptr) {
+      population->footprint(footprint);
+      continue;
+    }
+    ++footprint.agents;
+    footprint.agent_bytes += agent_bytes;
+    size_t events = agent->size();
+    if (agent->_contactEvents) {
+      footprint.agent_bytes += calendar_bytes;
+      // the contact calendar is scheduled in the agent as an event
+      events = events - 1 + agent->_contactEvents->size();
+    }
+    footprint.events += events;
+    footprint.event_bytes += events * event_bytes;
+    footprint.state_bytes += objectSize(agent->state(), footprint);
+  }
+}
+
 PAgent Population::remove(Agent &agent)
 {
   if (agent._population != this) 
     stop("agent is not managed by this population");
+  PAgent a = extract(agent);
+  unschedule(a);
+  return a;
+}
+
+PAgent Population::extract(Agent &agent)
+{
   for (auto &c : _contacts)
     c->remove(agent);
-  agent._contactEvents->clearEvents();
+  agent.clearContactEvents();
   agent.deregistered(*this);
   agent._population = nullptr;
+  ++agent._membership;
   agent._membership_lease.reset();
+  agent.cancelDependents();
   unsigned int i = agent._index;
   agent._index = 0;
   size_t n = _agents.size();
@@ -113,10 +356,36 @@ PAgent Population::remove(Agent &agent)
     _agents[i]->_index = i;
   } else _agents[i]= nullptr;
   _agents.resize(n - 1);
-  unschedule(a);
   return a;
 }
 
+std::vector<PAgent> Population::remove(const std::vector<Agent*> &agents)
+{
+  std::unordered_set<Agent*> seen;
+  for (auto agent : agents) {
+    if (agent->_population != this)
+      stop("agent is not managed by this population");
+    if (!seen.insert(agent).second)
+      stop("an agent cannot be removed more than once");
+  }
+  std::vector<PAgent> removed;
+  removed.reserve(agents.size());
+  // the contact patterns are notified one agent at a time, because a
+  // network mirrors the swap removal from the agent list using the indices
+  for (auto agent : agents) {
+    State save = agent->vacate();
+    if (agent->_population != this) {
+      agent->_state = save;
+      unschedule(std::vector<PEvent>(removed.begin(), removed.end()));
+      stop("agent changed populations while leaving");
+    }
+    removed.push_back(extract(*agent));
+    agent->_state = save;
+  }
+  unschedule(std::vector<PEvent>(removed.begin(), removed.end()));
+  return removed;
+}
+
 void Population::setID(Simulation &sim)
 {
   Agent::setID(sim);
@@ -137,6 +406,9 @@ void Population::registered(Population &owner)
 
 void Population::deregistered(Population &owner)
 {
+  Simulation *sim = owner.simulation();
+  if (sim != nullptr)
+    sim->unindex(*this);
   for (const auto &contact : _contacts)
     owner.deregisterSubcontact(contact);
   for (const auto &contact : _subcontacts)
@@ -176,8 +448,10 @@ XP<Population> newPopulation(SEXP n, Nullable<Function> initializer = R_NilValue
   return XP<Population>(makeOwned<Population>(N, initializer));
 }
 
-// [[Rcpp::export]]
-void addAgent(XP<Population> population, XP<Agent> agent)
+/**
+ * The owning pointer to an agent passed from R
+ */
+static PAgent managedAgent(XP<Agent> agent)
 {
   Agent *raw = agent;
   PAgent managed = agent;
@@ -185,9 +459,41 @@ void addAgent(XP<Population> population, XP<Agent> agent)
     managed = PAgent(raw);
   if (!managed)
     stop("agent is not managed by R or a population");
+  return managed;
+}
+
+// [[Rcpp::export]]
+void addAgent(XP<Population> population, XP<Agent> agent)
+{
+  population->add(managedAgent(agent));
+}
+
+// [[Rcpp::export]]
+void addAgents(XP<Population> population, List agents)
+{
+  std::vector<PAgent> managed;
+  managed.reserve(agents.size());
+  for (R_xlen_t i = 0; i < agents.size(); ++i)
+    managed.push_back(managedAgent(XP<Agent>(SEXP(agents[i]))));
   population->add(managed);
 }
 
+// [[Rcpp::export]]
+List removeAgents(XP<Population> population, List agents)
+{
+  std::vector<Agent*> raw;
+  raw.reserve(agents.size());
+  for (R_xlen_t i = 0; i < agents.size(); ++i) {
+    XP<Agent> agent(SEXP(agents[i]));
+    raw.push_back(agent);
+  }
+  std::vector<PAgent> removed = population->remove(raw);
+  List result(removed.size());
+  for (size_t i = 0; i < removed.size(); ++i)
+    result[i] = XP<Agent>(removed[i]);
+  return result;
+}
+
 // [[Rcpp::export]]
 int getSize(XP<Population> population)
 {
@@ -229,3 +535,32 @@ void setStates(XP<Population> population, SEXP states)
     }
   } else stop("invalid states. Must be a function or a list");
 }
+
+// [[Rcpp::export]]
+DataFrame populationMemoryFootprint(XP<Population> population)
+{
+  Population::Footprint footprint;
+  population->footprint(footprint);
+  size_t slabs = 0, blocks = 0, reserved = 0, used = 0;
+  for (size_t size = Pool::ALIGNMENT; size <= Pool::MAX_SIZE;
+       size += Pool::ALIGNMENT) {
+    const Pool *pool = Pool::of(size);
+    slabs += pool->slabs();
+    reserved += pool->slabs() * Pool::SLAB_SIZE;
+    blocks += pool->used();
+    used += pool->used() * pool->size();
+  }
+  CharacterVector component = CharacterVector::create(
+    "agents", "events", "states", "pool_used", "pool_reserved");
+  NumericVector count = NumericVector::create(
+    footprint.agents, footprint.events, footprint.state_objects, blocks,
+    slabs);
+  NumericVector bytes = NumericVector::create(
+    footprint.agent_bytes, footprint.event_bytes, footprint.state_bytes,
+    used, reserved);
+  return DataFrame::create(
+    Named("component") = component,
+    Named("count") = count,
+    Named("bytes") = bytes,
+    Named("stringsAsFactors") = false);
+}
@@ -0,0 +1,102 @@
+#include "../inst/include/Simulation.h"
+
+using namespace Rcpp;
+
+Profile *Profile::_current = nullptr;
+
+static const char *metric_names[Profile::N_METRICS] = {
+  "transition_event",
+  "contact_event",
+  "death_event",
+  "r_event",
+  "batch_event",
+  "reaction_event",
+  "schedule",
+  "unschedule",
+  "cascade",
+  "rule_match",
+  "stale_contact",
+  "r_callback",
+  "rng_refill",
+  "resume"
+};
+
+static bool timed(int metric)
+{
+  return metric == Profile::R_CALLBACK || metric == Profile::RESUME;
+}
+
+Profile::Profile()
+{
+  reset();
+}
+
+void Profile::reset()
+{
+  for (int i = 0; i < N_METRICS; ++i) {
+    _count[i] = 0;
+    _time[i] = 0;
+  }
+  _depth = 0;
+  _max_depth = 0;
+}
+
+DataFrame Profile::report() const
+{
+  const int n = N_METRICS;
+  CharacterVector metric(n + 1);
+  NumericVector count(n + 1), time(n + 1);
+  for (int i = 0; i < n; ++i) {
+    metric[i] = metric_names[i];
+    count[i] = _count[i];
+    time[i] = timed(i) ? _time[i] : NA_REAL;
+  }
+  metric[n] = "max_cascade_depth";
+  count[n] = _max_depth;
+  time[n] = NA_REAL;
+  return DataFrame::create(
+    Named("metric") = metric,
+    Named("count") = count,
+    Named("time") = time,
+    Named("stringsAsFactors") = false);
+}
+
+Profile::Scope::Scope(Profile *profile)
+  : _previous(_current)
+{
+  _current = profile;
+}
+
+Profile::Scope::~Scope()
+{
+  _current = _previous;
+}
+
+Profile::Timer::Timer(Metric metric)
+  : _profile(_current), _metric(metric)
+{
+  if (_profile != nullptr)
+    _start = std::chrono::steady_clock::now();
+}
+
+Profile::Timer::~Timer()
+{
+  if (_profile != nullptr) {
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - _start;
+    _profile->count(_metric);
+    _profile->time(_metric, elapsed.count());
+  }
+}
+
+// [[Rcpp::export]]
+void setSimulationProfiling(XP<Simulation> sim, bool enabled = true)
+{
+  sim->setProfiling(enabled);
+}
+
+// [[Rcpp::export]]
+DataFrame simulationProfile(XP<Simulation> sim)
+{
+  return sim->profile().report();
+}
@@ -1,4 +1,5 @@
 #include "../inst/include/RNG.h"
+#include "../inst/include/Profile.h"
 
 using namespace Rcpp;
 
@@ -10,6 +11,7 @@ RealRN::RealRN(size_t cache_size)
 double RealRN::get()
 {
   if (_pos >= _cache_size) {
+    Profile::record(Profile::RNG_REFILL);
     RNGScope rngScope;
     _cache = refill(_cache_size);
     _pos = 0;
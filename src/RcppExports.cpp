@@ -110,6 +110,102 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// newAggregatePopulation
+XP<AggregatePopulation> newAggregatePopulation(List states, NumericVector counts, SEXP contact);
+RcppExport SEXP _ABM_newAggregatePopulation(SEXP statesSEXP, SEXP countsSEXP, SEXP contactSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type states(statesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type counts(countsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type contact(contactSEXP);
+    rcpp_result_gen = Rcpp::wrap(newAggregatePopulation(states, counts, contact));
+    return rcpp_result_gen;
+END_RCPP
+}
+// getCompartments
+List getCompartments(XP<AggregatePopulation> population);
+RcppExport SEXP _ABM_getCompartments(SEXP populationSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<AggregatePopulation> >::type population(populationSEXP);
+    rcpp_result_gen = Rcpp::wrap(getCompartments(population));
+    return rcpp_result_gen;
+END_RCPP
+}
+// setTauLeaping
+void setTauLeaping(XP<AggregatePopulation> population, double epsilon);
+RcppExport SEXP _ABM_setTauLeaping(SEXP populationSEXP, SEXP epsilonSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<AggregatePopulation> >::type population(populationSEXP);
+    Rcpp::traits::input_parameter< double >::type epsilon(epsilonSEXP);
+    setTauLeaping(population, epsilon);
+    return R_NilValue;
+END_RCPP
+}
+// materializeAgents
+List materializeAgents(XP<AggregatePopulation> aggregate, List rule, int k, XP<Population> population);
+RcppExport SEXP _ABM_materializeAgents(SEXP aggregateSEXP, SEXP ruleSEXP, SEXP kSEXP, SEXP populationSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<AggregatePopulation> >::type aggregate(aggregateSEXP);
+    Rcpp::traits::input_parameter< List >::type rule(ruleSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< XP<Population> >::type population(populationSEXP);
+    rcpp_result_gen = Rcpp::wrap(materializeAgents(aggregate, rule, k, population));
+    return rcpp_result_gen;
+END_RCPP
+}
+// newNativeCallback
+XP<Callback> newNativeCallback(SEXP callback, SEXP data);
+RcppExport SEXP _ABM_newNativeCallback(SEXP callbackSEXP, SEXP dataSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type callback(callbackSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type data(dataSEXP);
+    rcpp_result_gen = Rcpp::wrap(newNativeCallback(callback, data));
+    return rcpp_result_gen;
+END_RCPP
+}
+// newProbabilityCallback
+XP<Callback> newProbabilityCallback(double p);
+RcppExport SEXP _ABM_newProbabilityCallback(SEXP pSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type p(pSEXP);
+    rcpp_result_gen = Rcpp::wrap(newProbabilityCallback(p));
+    return rcpp_result_gen;
+END_RCPP
+}
+// newTimestampCallback
+XP<Callback> newTimestampCallback(std::string name);
+RcppExport SEXP _ABM_newTimestampCallback(SEXP nameSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type name(nameSEXP);
+    rcpp_result_gen = Rcpp::wrap(newTimestampCallback(name));
+    return rcpp_result_gen;
+END_RCPP
+}
+// newBatchCallback
+XP<Callback> newBatchCallback(Function f, double window, bool states);
+RcppExport SEXP _ABM_newBatchCallback(SEXP fSEXP, SEXP windowSEXP, SEXP statesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Function >::type f(fSEXP);
+    Rcpp::traits::input_parameter< double >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< bool >::type states(statesSEXP);
+    rcpp_result_gen = Rcpp::wrap(newBatchCallback(f, window, states));
+    return rcpp_result_gen;
+END_RCPP
+}
 // newRandomMixing
 XP<Contact> newRandomMixing(SEXP rate, std::string type);
 RcppExport SEXP _ABM_newRandomMixing(SEXP rateSEXP, SEXP typeSEXP) {
@@ -184,6 +280,18 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// newCrossTab
+XP<CrossTab> newCrossTab(std::string name, List levels);
+RcppExport SEXP _ABM_newCrossTab(SEXP nameSEXP, SEXP levelsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< List >::type levels(levelsSEXP);
+    rcpp_result_gen = Rcpp::wrap(newCrossTab(name, levels));
+    return rcpp_result_gen;
+END_RCPP
+}
 // newEvent
 XP<Event> newEvent(double time, Function handler);
 RcppExport SEXP _ABM_newEvent(SEXP timeSEXP, SEXP handlerSEXP) {
@@ -207,30 +315,55 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// newGroupedEventLogger
+XP<EventLogger> newGroupedEventLogger(std::string name, double change, List levels, SEXP filter);
+RcppExport SEXP _ABM_newGroupedEventLogger(SEXP nameSEXP, SEXP changeSEXP, SEXP levelsSEXP, SEXP filterSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< double >::type change(changeSEXP);
+    Rcpp::traits::input_parameter< List >::type levels(levelsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type filter(filterSEXP);
+    rcpp_result_gen = Rcpp::wrap(newGroupedEventLogger(name, change, levels, filter));
+    return rcpp_result_gen;
+END_RCPP
+}
 // newIncrementLogger
-XP<EventLogger> newIncrementLogger(std::string variable, Nullable<Function> filter);
+XP<EventLogger> newIncrementLogger(std::string variable, SEXP filter);
 RcppExport SEXP _ABM_newIncrementLogger(SEXP variableSEXP, SEXP filterSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< std::string >::type variable(variableSEXP);
-    Rcpp::traits::input_parameter< Nullable<Function> >::type filter(filterSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type filter(filterSEXP);
     rcpp_result_gen = Rcpp::wrap(newIncrementLogger(variable, filter));
     return rcpp_result_gen;
 END_RCPP
 }
 // newDecrementLogger
-XP<EventLogger> newDecrementLogger(std::string variable, Nullable<Function> filter);
+XP<EventLogger> newDecrementLogger(std::string variable, SEXP filter);
 RcppExport SEXP _ABM_newDecrementLogger(SEXP variableSEXP, SEXP filterSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< std::string >::type variable(variableSEXP);
-    Rcpp::traits::input_parameter< Nullable<Function> >::type filter(filterSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type filter(filterSEXP);
     rcpp_result_gen = Rcpp::wrap(newDecrementLogger(variable, filter));
     return rcpp_result_gen;
 END_RCPP
 }
+// newExpressionCallback
+XP<Callback> newExpressionCallback(SEXP formula);
+RcppExport SEXP _ABM_newExpressionCallback(SEXP formulaSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type formula(formulaSEXP);
+    rcpp_result_gen = Rcpp::wrap(newExpressionCallback(formula));
+    return rcpp_result_gen;
+END_RCPP
+}
 // newConfigurationModel
 XP<ConfigurationModel> newConfigurationModel(Function rng, SEXP rate, std::string type);
 RcppExport SEXP _ABM_newConfigurationModel(SEXP rngSEXP, SEXP rateSEXP, SEXP typeSEXP) {
@@ -267,6 +400,29 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// addAgents
+void addAgents(XP<Population> population, List agents);
+RcppExport SEXP _ABM_addAgents(SEXP populationSEXP, SEXP agentsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Population> >::type population(populationSEXP);
+    Rcpp::traits::input_parameter< List >::type agents(agentsSEXP);
+    addAgents(population, agents);
+    return R_NilValue;
+END_RCPP
+}
+// removeAgents
+List removeAgents(XP<Population> population, List agents);
+RcppExport SEXP _ABM_removeAgents(SEXP populationSEXP, SEXP agentsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Population> >::type population(populationSEXP);
+    Rcpp::traits::input_parameter< List >::type agents(agentsSEXP);
+    rcpp_result_gen = Rcpp::wrap(removeAgents(population, agents));
+    return rcpp_result_gen;
+END_RCPP
+}
 // getSize
 int getSize(XP<Population> population);
 RcppExport SEXP _ABM_getSize(SEXP populationSEXP) {
@@ -312,6 +468,39 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// populationMemoryFootprint
+DataFrame populationMemoryFootprint(XP<Population> population);
+RcppExport SEXP _ABM_populationMemoryFootprint(SEXP populationSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Population> >::type population(populationSEXP);
+    rcpp_result_gen = Rcpp::wrap(populationMemoryFootprint(population));
+    return rcpp_result_gen;
+END_RCPP
+}
+// setSimulationProfiling
+void setSimulationProfiling(XP<Simulation> sim, bool enabled);
+RcppExport SEXP _ABM_setSimulationProfiling(SEXP simSEXP, SEXP enabledSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    Rcpp::traits::input_parameter< bool >::type enabled(enabledSEXP);
+    setSimulationProfiling(sim, enabled);
+    return R_NilValue;
+END_RCPP
+}
+// simulationProfile
+DataFrame simulationProfile(XP<Simulation> sim);
+RcppExport SEXP _ABM_simulationProfile(SEXP simSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    rcpp_result_gen = Rcpp::wrap(simulationProfile(sim));
+    return rcpp_result_gen;
+END_RCPP
+}
 // newSimulation
 XP<Simulation> newSimulation(SEXP n, Nullable<Function> initializer);
 RcppExport SEXP _ABM_newSimulation(SEXP nSEXP, SEXP initializerSEXP) {
@@ -348,6 +537,17 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// hasContactTransitions
+bool hasContactTransitions(XP<Simulation> sim);
+RcppExport SEXP _ABM_hasContactTransitions(SEXP simSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    rcpp_result_gen = Rcpp::wrap(hasContactTransitions(sim));
+    return rcpp_result_gen;
+END_RCPP
+}
 // addLogger
 void addLogger(XP<Simulation> sim, XP<Logger> logger);
 RcppExport SEXP _ABM_addLogger(SEXP simSEXP, SEXP loggerSEXP) {
@@ -360,7 +560,7 @@ BEGIN_RCPP
 END_RCPP
 }
 // addTransition
-void addTransition(XP<Simulation> sim, List from, Nullable<List> contact_from, List to, Nullable<List> contact_to, SEXP contact, SEXP waiting_time, Nullable<Function> to_change_callback, Nullable<Function> changed_callback, Nullable<List> logging);
+void addTransition(XP<Simulation> sim, List from, Nullable<List> contact_from, List to, Nullable<List> contact_to, SEXP contact, SEXP waiting_time, SEXP to_change_callback, SEXP changed_callback, Nullable<List> logging);
 RcppExport SEXP _ABM_addTransition(SEXP simSEXP, SEXP fromSEXP, SEXP contact_fromSEXP, SEXP toSEXP, SEXP contact_toSEXP, SEXP contactSEXP, SEXP waiting_timeSEXP, SEXP to_change_callbackSEXP, SEXP changed_callbackSEXP, SEXP loggingSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -371,13 +571,63 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< Nullable<List> >::type contact_to(contact_toSEXP);
     Rcpp::traits::input_parameter< SEXP >::type contact(contactSEXP);
     Rcpp::traits::input_parameter< SEXP >::type waiting_time(waiting_timeSEXP);
-    Rcpp::traits::input_parameter< Nullable<Function> >::type to_change_callback(to_change_callbackSEXP);
-    Rcpp::traits::input_parameter< Nullable<Function> >::type changed_callback(changed_callbackSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type to_change_callback(to_change_callbackSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type changed_callback(changed_callbackSEXP);
     Rcpp::traits::input_parameter< Nullable<List> >::type logging(loggingSEXP);
     addTransition(sim, from, contact_from, to, contact_to, contact, waiting_time, to_change_callback, changed_callback, logging);
     return R_NilValue;
 END_RCPP
 }
+// addTemporalLogger
+void addTemporalLogger(XP<Simulation> sim, std::string name, std::string logger, std::string statistic, double threshold);
+RcppExport SEXP _ABM_addTemporalLogger(SEXP simSEXP, SEXP nameSEXP, SEXP loggerSEXP, SEXP statisticSEXP, SEXP thresholdSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    Rcpp::traits::input_parameter< std::string >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< std::string >::type logger(loggerSEXP);
+    Rcpp::traits::input_parameter< std::string >::type statistic(statisticSEXP);
+    Rcpp::traits::input_parameter< double >::type threshold(thresholdSEXP);
+    addTemporalLogger(sim, name, logger, statistic, threshold);
+    return R_NilValue;
+END_RCPP
+}
+// addStateIndex
+void addStateIndex(XP<Simulation> sim, CharacterVector domains);
+RcppExport SEXP _ABM_addStateIndex(SEXP simSEXP, SEXP domainsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type domains(domainsSEXP);
+    addStateIndex(sim, domains);
+    return R_NilValue;
+END_RCPP
+}
+// countAgents
+double countAgents(XP<Simulation> sim, List rule);
+RcppExport SEXP _ABM_countAgents(SEXP simSEXP, SEXP ruleSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    Rcpp::traits::input_parameter< List >::type rule(ruleSEXP);
+    rcpp_result_gen = Rcpp::wrap(countAgents(sim, rule));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sampleAgents
+List sampleAgents(XP<Simulation> sim, List rule, int k);
+RcppExport SEXP _ABM_sampleAgents(SEXP simSEXP, SEXP ruleSEXP, SEXP kSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    Rcpp::traits::input_parameter< List >::type rule(ruleSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(sampleAgents(sim, rule, k));
+    return rcpp_result_gen;
+END_RCPP
+}
 // stateMatch
 bool stateMatch(List state, SEXP rule);
 RcppExport SEXP _ABM_stateMatch(SEXP stateSEXP, SEXP ruleSEXP) {
@@ -390,6 +640,54 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// addLoggerStop
+void addLoggerStop(XP<Simulation> sim, std::string logger, double below, double above);
+RcppExport SEXP _ABM_addLoggerStop(SEXP simSEXP, SEXP loggerSEXP, SEXP belowSEXP, SEXP aboveSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    Rcpp::traits::input_parameter< std::string >::type logger(loggerSEXP);
+    Rcpp::traits::input_parameter< double >::type below(belowSEXP);
+    Rcpp::traits::input_parameter< double >::type above(aboveSEXP);
+    addLoggerStop(sim, logger, below, above);
+    return R_NilValue;
+END_RCPP
+}
+// addCountStop
+void addCountStop(XP<Simulation> sim, List rule, double below, double above);
+RcppExport SEXP _ABM_addCountStop(SEXP simSEXP, SEXP ruleSEXP, SEXP belowSEXP, SEXP aboveSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    Rcpp::traits::input_parameter< List >::type rule(ruleSEXP);
+    Rcpp::traits::input_parameter< double >::type below(belowSEXP);
+    Rcpp::traits::input_parameter< double >::type above(aboveSEXP);
+    addCountStop(sim, rule, below, above);
+    return R_NilValue;
+END_RCPP
+}
+// addBudgetStop
+void addBudgetStop(XP<Simulation> sim, double seconds, double events);
+RcppExport SEXP _ABM_addBudgetStop(SEXP simSEXP, SEXP secondsSEXP, SEXP eventsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    Rcpp::traits::input_parameter< double >::type seconds(secondsSEXP);
+    Rcpp::traits::input_parameter< double >::type events(eventsSEXP);
+    addBudgetStop(sim, seconds, events);
+    return R_NilValue;
+END_RCPP
+}
+// clearStopConditions
+void clearStopConditions(XP<Simulation> sim);
+RcppExport SEXP _ABM_clearStopConditions(SEXP simSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< XP<Simulation> >::type sim(simSEXP);
+    clearStopConditions(sim);
+    return R_NilValue;
+END_RCPP
+}
 // newExpWaitingTime
 XP<WaitingTime> newExpWaitingTime(double rate);
 RcppExport SEXP _ABM_newExpWaitingTime(SEXP rateSEXP) {
@@ -437,6 +735,8 @@ BEGIN_RCPP
 END_RCPP
 }
 
+void registerNativeCallables(DllInfo * dll);
+
 static const R_CallMethodDef CallEntries[] = {
     {"_ABM_newAgent", (DL_FUNC) &_ABM_newAgent, 2},
     {"_ABM_getID", (DL_FUNC) &_ABM_getID, 1},
@@ -447,29 +747,54 @@ static const R_CallMethodDef CallEntries[] = {
     {"_ABM_setState", (DL_FUNC) &_ABM_setState, 2},
     {"_ABM_leave", (DL_FUNC) &_ABM_leave, 1},
     {"_ABM_setDeathTime", (DL_FUNC) &_ABM_setDeathTime, 2},
+    {"_ABM_newAggregatePopulation", (DL_FUNC) &_ABM_newAggregatePopulation, 3},
+    {"_ABM_getCompartments", (DL_FUNC) &_ABM_getCompartments, 1},
+    {"_ABM_setTauLeaping", (DL_FUNC) &_ABM_setTauLeaping, 2},
+    {"_ABM_materializeAgents", (DL_FUNC) &_ABM_materializeAgents, 4},
+    {"_ABM_newNativeCallback", (DL_FUNC) &_ABM_newNativeCallback, 2},
+    {"_ABM_newProbabilityCallback", (DL_FUNC) &_ABM_newProbabilityCallback, 1},
+    {"_ABM_newTimestampCallback", (DL_FUNC) &_ABM_newTimestampCallback, 1},
+    {"_ABM_newBatchCallback", (DL_FUNC) &_ABM_newBatchCallback, 3},
     {"_ABM_newRandomMixing", (DL_FUNC) &_ABM_newRandomMixing, 2},
     {"_ABM_newContact", (DL_FUNC) &_ABM_newContact, 3},
     {"_ABM_getContactType", (DL_FUNC) &_ABM_getContactType, 1},
     {"_ABM_isContactAttached", (DL_FUNC) &_ABM_isContactAttached, 1},
     {"_ABM_newCounter", (DL_FUNC) &_ABM_newCounter, 4},
     {"_ABM_newStateLogger", (DL_FUNC) &_ABM_newStateLogger, 3},
+    {"_ABM_newCrossTab", (DL_FUNC) &_ABM_newCrossTab, 2},
     {"_ABM_newEvent", (DL_FUNC) &_ABM_newEvent, 2},
     {"_ABM_getTime", (DL_FUNC) &_ABM_getTime, 1},
+    {"_ABM_newGroupedEventLogger", (DL_FUNC) &_ABM_newGroupedEventLogger, 4},
     {"_ABM_newIncrementLogger", (DL_FUNC) &_ABM_newIncrementLogger, 2},
     {"_ABM_newDecrementLogger", (DL_FUNC) &_ABM_newDecrementLogger, 2},
+    {"_ABM_newExpressionCallback", (DL_FUNC) &_ABM_newExpressionCallback, 1},
     {"_ABM_newConfigurationModel", (DL_FUNC) &_ABM_newConfigurationModel, 3},
     {"_ABM_newPopulation", (DL_FUNC) &_ABM_newPopulation, 2},
     {"_ABM_addAgent", (DL_FUNC) &_ABM_addAgent, 2},
+    {"_ABM_addAgents", (DL_FUNC) &_ABM_addAgents, 2},
+    {"_ABM_removeAgents", (DL_FUNC) &_ABM_removeAgents, 2},
     {"_ABM_getSize", (DL_FUNC) &_ABM_getSize, 1},
     {"_ABM_getAgent", (DL_FUNC) &_ABM_getAgent, 2},
     {"_ABM_addContact", (DL_FUNC) &_ABM_addContact, 2},
     {"_ABM_setStates", (DL_FUNC) &_ABM_setStates, 2},
+    {"_ABM_populationMemoryFootprint", (DL_FUNC) &_ABM_populationMemoryFootprint, 1},
+    {"_ABM_setSimulationProfiling", (DL_FUNC) &_ABM_setSimulationProfiling, 2},
+    {"_ABM_simulationProfile", (DL_FUNC) &_ABM_simulationProfile, 1},
     {"_ABM_newSimulation", (DL_FUNC) &_ABM_newSimulation, 2},
     {"_ABM_runSimulation", (DL_FUNC) &_ABM_runSimulation, 2},
     {"_ABM_resumeSimulation", (DL_FUNC) &_ABM_resumeSimulation, 2},
+    {"_ABM_hasContactTransitions", (DL_FUNC) &_ABM_hasContactTransitions, 1},
     {"_ABM_addLogger", (DL_FUNC) &_ABM_addLogger, 2},
     {"_ABM_addTransition", (DL_FUNC) &_ABM_addTransition, 10},
+    {"_ABM_addTemporalLogger", (DL_FUNC) &_ABM_addTemporalLogger, 5},
+    {"_ABM_addStateIndex", (DL_FUNC) &_ABM_addStateIndex, 2},
+    {"_ABM_countAgents", (DL_FUNC) &_ABM_countAgents, 2},
+    {"_ABM_sampleAgents", (DL_FUNC) &_ABM_sampleAgents, 3},
     {"_ABM_stateMatch", (DL_FUNC) &_ABM_stateMatch, 2},
+    {"_ABM_addLoggerStop", (DL_FUNC) &_ABM_addLoggerStop, 4},
+    {"_ABM_addCountStop", (DL_FUNC) &_ABM_addCountStop, 4},
+    {"_ABM_addBudgetStop", (DL_FUNC) &_ABM_addBudgetStop, 3},
+    {"_ABM_clearStopConditions", (DL_FUNC) &_ABM_clearStopConditions, 1},
     {"_ABM_newExpWaitingTime", (DL_FUNC) &_ABM_newExpWaitingTime, 1},
     {"_ABM_newGammaWaitingTime", (DL_FUNC) &_ABM_newGammaWaitingTime, 2},
     {"_ABM_newRWaitingTime", (DL_FUNC) &_ABM_newRWaitingTime, 1},
@@ -480,4 +805,5 @@ static const R_CallMethodDef CallEntries[] = {
 RcppExport void R_init_ABM(DllInfo *dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    registerNativeCallables(dll);
 }
@@ -1,18 +1,21 @@
 #include "../inst/include/Simulation.h"
+#include <algorithm>
 #include <cmath>
 #include <set>
 
 using namespace Rcpp;
 
 Simulation::Simulation(size_t n, Rcpp::Nullable<Rcpp::Function> initializer)
-  : Population(n, initializer), _current_time(R_NaN), _next_id(0)
+  : Population(n, initializer), _handled(0), _current_time(R_NaN),
+    _profiling(false), _next_id(0)
 {
   for (auto a : _agents)
     a->setID(*this);
 }
 
 Simulation::Simulation(List states)
-  : Population(states), _current_time(R_NaN), _next_id(0)
+  : Population(states), _handled(0), _current_time(R_NaN),
+    _profiling(false), _next_id(0)
 {
   for (auto a : _agents)
     a->setID(*this);
@@ -85,6 +88,8 @@ List Simulation::run(const NumericVector &time)
     if (_current_time > time[0]) 
       _current_time = time[0];
     report();
+    for (auto logger : _temporal_loggers)
+      logger->begin(_current_time);
   }
   return resume(time);
 }
@@ -93,30 +98,111 @@ List Simulation::resume(const NumericVector &time)
 {
   size_t n = time.size();
   if (n == 0) return List();
+  Profile::Scope scope(_profiling ? &_profile : nullptr);
+  Profile::Timer timer(Profile::RESUME);
   std::map<std::string, NumericVector> result;
-  for (auto c : _loggers)
-    result[c->name()] = NumericVector(n);
+  // the cells reported by the loggers of tables, one row for each report
+  std::vector<std::pair<Logger*, std::vector<double> > > tables;
+  for (auto c : _loggers) {
+    if (c->cells() > 0)
+      tables.emplace_back(c.get(), std::vector<double>(n * c->cells()));
+    else result[c->name()] = NumericVector(n);
+  }
+  _stop_reason.clear();
+  _handled = 0;
+  for (auto &condition : _stop_conditions)
+    condition->start();
+  observe();
   size_t i = 0;
   for (auto report : time) {
-    while (report > _time) {
+    while (!stopping() && report > _time) {
       _current_time = _time;
       this->handle(*this, *this);
+      ++_handled;
+      observe();
     }
+    if (!_stop_reason.empty()) break;
     _current_time = report;
+    observe();
     for (auto c : _loggers)
-      result[c->name()][i] = c->report();
+      if (c->cells() == 0)
+        result[c->name()][i] = c->report();
+    for (auto &table : tables)
+      table.first->reportCells(table.second.data() + i * table.first->cells());
     ++i;
   }
+  // a run that stopped early returns the reports up to the stop
+  auto head = [i](const NumericVector &x) {
+    return i == static_cast<size_t>(x.size()) ? x :
+      NumericVector(x.begin(), x.begin() + i);
+  };
   List r;
-  r["times"] = time;
+  r["times"] = head(time);
   for (auto x : result)
-    r[x.first] = x.second;
+    r[x.first] = head(x.second);
+  if (!_stop_reason.empty())
+    r.attr("stop") = _stop_reason;
+  if (!tables.empty()) {
+    List t;
+    for (auto &table : tables)
+      t[table.first->name()] =
+        table.first->tabulate(head(time), table.second.data());
+    r.attr("tables") = t;
+  }
   return r;
 }
 
+void Simulation::observe()
+{
+  for (auto logger : _temporal_loggers)
+    logger->observe(_current_time);
+}
+
+bool Simulation::stopping()
+{
+  if (!_stop_reason.empty()) return true;
+  for (auto &condition : _stop_conditions) {
+    if (condition->met(*this)) {
+      _stop_reason = condition->reason();
+      return true;
+    }
+  }
+  return false;
+}
+
+SEXP Simulation::borrowSimulation(const XPScope &scope)
+{
+  if (!_simulation_handle)
+    _simulation_handle = std::make_unique<XPHandle<Simulation> >();
+  return _simulation_handle->borrow(*this, scope);
+}
+
+PLogger Simulation::logger(const std::string &name) const
+{
+  for (const auto &logger : _loggers)
+    if (logger->name() == name)
+      return logger;
+  return PLogger();
+}
+
+void Simulation::addStopCondition(std::unique_ptr<StopCondition> condition)
+{
+  _stop_conditions.push_back(std::move(condition));
+}
+
+void Simulation::clearStopConditions()
+{
+  _stop_conditions.clear();
+}
+
 void Simulation::stateChanged(Agent &agent, const State &from)
 {
+  for (auto &index : _indexes)
+    index.update(agent);
   if (!std::isnan(_current_time)) {
+    if (Profile::current() != nullptr)
+      Profile::current()->count(Profile::RULE_MATCH,
+        _transitions.size() + _contact_transitions.size());
     for (auto c : _loggers)
       c->log(agent, from);
     for (auto r : _transitions) {
@@ -130,15 +216,51 @@ void Simulation::stateChanged(Agent &agent, const State &from)
   }
 }
 
+void Simulation::log(Agent &agent, const State &from)
+{
+  if (!std::isnan(_current_time))
+    for (auto c : _loggers)
+      c->log(agent, from);
+}
+
+void Simulation::log(Agent &agent, const State &from, double count)
+{
+  if (!std::isnan(_current_time))
+    for (auto c : _loggers)
+      c->log(agent, from, count);
+}
+
 void Simulation::stateChanging(Agent &agent, const Rcpp::List &state)
 {
   _pending_loggers.clear();
   _pending_transitions.clear();
   _pending_contact_transitions.clear();
   if (!std::isnan(_current_time)) {
-    for (auto logger : _loggers)
+    if (Profile::current() != nullptr)
+      Profile::current()->count(Profile::RULE_MATCH,
+        _transitions.size() + _contact_transitions.size());
+    for (auto logger : _polled_loggers)
       if (logger->stateChanging(agent, state))
-        _pending_loggers.push_back(logger.get());
+        _pending_loggers.push_back(logger);
+    // only the loggers that watch a domain set by the change are selected,
+    // each once; unnamed values set the unnamed domain, which is not watched
+    SEXP ns = state.names();
+    if (ns != R_NilValue && !_watches.empty()) {
+      size_t polled = _pending_loggers.size();
+      R_xlen_t n = XLENGTH(ns);
+      for (R_xlen_t i = 0; i < n; ++i) {
+        for (auto &watch : _watches) {
+          if (!State::same(watch.domain, STRING_ELT(ns, i))) continue;
+          for (auto logger : watch.loggers) {
+            auto begin = _pending_loggers.begin() + polled;
+            if (std::find(begin, _pending_loggers.end(), logger) ==
+                _pending_loggers.end() &&
+                logger->stateChanging(agent, state))
+              _pending_loggers.push_back(logger);
+          }
+        }
+      }
+    }
     for (auto rule : _transitions)
       if (!agent.match(rule->from()))
         _pending_transitions.push_back(rule);
@@ -150,7 +272,12 @@ void Simulation::stateChanging(Agent &agent, const Rcpp::List &state)
 
 void Simulation::stateChanged(Agent &agent)
 {
+  for (auto &index : _indexes)
+    index.update(agent);
   if (!std::isnan(_current_time)) {
+    if (Profile::current() != nullptr)
+      Profile::current()->count(Profile::RULE_MATCH,
+        _pending_transitions.size() + _pending_contact_transitions.size());
     for (auto logger : _pending_loggers)
       logger->stateChanged(agent);
     for (auto rule : _pending_transitions) {
@@ -176,6 +303,25 @@ void Simulation::add(PLogger logger)
     for (auto l : _loggers) 
       if (l == logger) return;
     _loggers.push_back(logger);
+    if (logger->temporal())
+      _temporal_loggers.push_back(logger.get());
+    std::vector<SEXP> domains;
+    if (!logger->watches(domains)) {
+      _polled_loggers.push_back(logger.get());
+      return;
+    }
+    for (auto domain : domains) {
+      auto watch = std::find_if(_watches.begin(), _watches.end(),
+        [domain](const Watch &w) { return State::same(w.domain, domain); });
+      if (watch == _watches.end()) {
+        _watches.push_back(Watch{domain, std::vector<Logger*>()});
+        watch = _watches.end() - 1;
+      }
+      auto &loggers = watch->loggers;
+      if (std::find(loggers.begin(), loggers.end(), logger.get()) ==
+          loggers.end())
+        loggers.push_back(logger.get());
+    }
   }
 }
 
@@ -199,21 +345,88 @@ void Simulation::add(ContactTransition *rule)
   }
 }
 
+void Simulation::addIndex(const std::vector<std::string> &domains)
+{
+  for (const auto &index : _indexes)
+    if (index.domains() == domains)
+      return;
+  _indexes.emplace_back(domains);
+  index(*this, _indexes.back());
+}
+
+void Simulation::index(Population &population, StateIndex &index)
+{
+  for (auto &agent : population._agents) {
+    index.update(*agent);
+    Population *nested = dynamic_cast<Population*>(agent.get());
+    if (nested != nullptr)
+      this->index(*nested, index);
+  }
+}
+
+void Simulation::unindex(Population &population)
+{
+  for (auto &agent : population._agents) {
+    for (auto &index : _indexes)
+      index.remove(*agent);
+    Population *nested = dynamic_cast<Population*>(agent.get());
+    if (nested != nullptr)
+      unindex(*nested);
+  }
+}
+
+StateIndex &Simulation::index(const List &rule)
+{
+  for (auto &index : _indexes)
+    if (index.covers(rule))
+      return index;
+  stop("no state index covers the domains of the rule");
+}
+
+size_t Simulation::count(const List &rule)
+{
+  return index(rule).count(rule);
+}
+
+std::vector<Agent*> Simulation::sample(const List &rule, size_t k)
+{
+  return index(rule).sample(rule, k);
+}
+
 void Simulation::change(const std::string &name, double delta)
 {
-  List current = state();
-  R_xlen_t position = current.findName(name);
+  CharacterVector symbol(1);
+  SET_STRING_ELT(symbol, 0, State::symbol(name));
+  change(STRING_ELT(symbol, 0), delta);
+}
+
+void Simulation::change(SEXP name, double delta)
+{
+  // the state of a simulation is not shared with the agents, so that it is
+  // changed in place
+  State &current = _state.own();
+  R_xlen_t position = current.find(name);
   if (position < 0)
-    stop("simulation state variable not found: ", name);
-  SEXP old = current[position];
+    stop("simulation state variable not found: ", Rf_translateChar(name));
+  SEXP old = VECTOR_ELT(current, position);
   if ((TYPEOF(old) != INTSXP && TYPEOF(old) != REALSXP) ||
       Rf_length(old) != 1)
-    stop("simulation state variable must be a numeric scalar: ", name);
-  double value = as<double>(current[position]);
-  List update(1);
-  update[0] = value + delta;
-  update.attr("names") = CharacterVector::create(name);
-  set(update, false);
+    stop("simulation state variable must be a numeric scalar: ",
+         Rf_translateChar(name));
+  double value;
+  if (TYPEOF(old) == REALSXP)
+    value = REAL(old)[0];
+  else value = INTEGER(old)[0] == NA_INTEGER ? NA_REAL : INTEGER(old)[0];
+  // the value is replaced in place, as set() would, without allocating an
+  // update list
+  SET_VECTOR_ELT(current, position, Rf_ScalarReal(value + delta));
+}
+
+void Simulation::setProfiling(bool enabled)
+{
+  if (enabled && !_profiling)
+    _profile.reset();
+  _profiling = enabled;
 }
 
 Simulation *Simulation::simulation()
@@ -255,6 +468,12 @@ List resumeSimulation(XP<Simulation> sim, NumericVector time)
   return sim->resume(time);
 }
 
+// [[Rcpp::export]]
+bool hasContactTransitions(XP<Simulation> sim)
+{
+  return !sim->contactTransitions().empty();
+}
+
 // [[Rcpp::export]]
 void addLogger(XP<Simulation> sim, XP<Logger> logger)
 {
@@ -286,8 +505,8 @@ void addTransition(
     List from, Nullable<List> contact_from, 
     List to, Nullable<List> contact_to, SEXP contact,
     SEXP waiting_time, 
-    Nullable<Function> to_change_callback = R_NilValue, 
-    Nullable<Function> changed_callback = R_NilValue,
+    SEXP to_change_callback = R_NilValue, 
+    SEXP changed_callback = R_NilValue,
     Nullable<List> logging = R_NilValue)
 {
   bool contact_rule = !contact_from.isNull() || !contact_to.isNull();
@@ -297,10 +516,13 @@ void addTransition(
   if (contact_rule && waiting_time != R_NilValue)
     warning("Supplying waiting.time for a contact transition is deprecated; "
             "specify the rate on the Contact instead");
-  if (to_change_callback != R_NilValue && !Rf_isFunction(to_change_callback))
-    stop("to_change_callback must be a function or NULL");
-  if (changed_callback != R_NilValue && !Rf_isFunction(changed_callback))
-    stop("changed_callback must be a function or NULL");
+  PCallback to_change = parseCallback(
+    to_change_callback, "to_change_callback");
+  PCallback changed = parseCallback(changed_callback, "changed_callback");
+  // a batch callback decides the deferred events of a to_change callback,
+  // and would be called for each event as a changed callback
+  if (dynamic_cast<BatchCallback*>(changed.get()) != nullptr)
+    stop("a batch callback can only be a to_change_callback");
 
   std::vector<PEventLogger> event_loggers;
   if (!logging.isNull()) {
@@ -310,6 +532,7 @@ void addTransition(
       if (!Rf_inherits(l[i], "EventLogger"))
         stop("logging must contain EventLogger objects");
       XP<EventLogger> logger(l[i]);
+      logger->attach(*sim);
       event_loggers.push_back(logger);
     }
   }
@@ -318,7 +541,7 @@ void addTransition(
     if (contact != R_NilValue)
       stop("contact states are required for a contact transition");
     sim->add(new Transition(
-      from, to, w, to_change_callback, changed_callback, event_loggers));
+      from, to, w, to_change, changed, event_loggers));
   } else {
     if (contact_from.isNull())
       stop("contact from state is NULL");
@@ -329,6 +552,42 @@ void addTransition(
     if (contact != R_NilValue)
       type = contactType(contact);
     sim->add(new ContactTransition(from, cf, to, ct,
-        type, w, to_change_callback, changed_callback, event_loggers));
+        type, w, to_change, changed, event_loggers));
   }
 }
+
+// [[Rcpp::export]]
+void addTemporalLogger(XP<Simulation> sim, std::string name,
+                       std::string logger, std::string statistic,
+                       double threshold = NA_REAL)
+{
+  PLogger source = sim->logger(logger);
+  if (!source)
+    stop("the simulation has no logger named ", logger);
+  sim->add(PLogger(makeOwned<TemporalLogger>(
+    name, source, TemporalLogger::statistic(statistic), threshold)));
+}
+
+// [[Rcpp::export]]
+void addStateIndex(XP<Simulation> sim, CharacterVector domains)
+{
+  sim->addIndex(as<std::vector<std::string>>(domains));
+}
+
+// [[Rcpp::export]]
+double countAgents(XP<Simulation> sim, List rule)
+{
+  return sim->count(rule);
+}
+
+// [[Rcpp::export]]
+List sampleAgents(XP<Simulation> sim, List rule, int k)
+{
+  if (k < 0)
+    stop("k must not be negative");
+  std::vector<Agent*> agents = sim->sample(rule, static_cast<size_t>(k));
+  List result(agents.size());
+  for (size_t i = 0; i < agents.size(); ++i)
+    result[i] = XP<Agent>(PAgent(agents[i]));
+  return result;
+}
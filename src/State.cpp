@@ -1,5 +1,9 @@
 #include "../inst/include/State.h"
+#include <cmath>
+#include <cstring>
+#include <functional>
 #include <string>
+#include <vector>
 
 using namespace Rcpp;
 
@@ -69,6 +73,28 @@ bool comp(SEXP x, SEXP y) {
   return ok;
 }
 
+bool State::same(SEXP x, SEXP y)
+{
+  if (x == y) return true;
+  if (Rf_getCharCE(x) == Rf_getCharCE(y)) return false;
+  return std::strcmp(Rf_translateCharUTF8(x), Rf_translateCharUTF8(y)) == 0;
+}
+
+R_xlen_t State::find(SEXP name) const
+{
+  SEXP ns = Rf_getAttrib(*this, R_NamesSymbol);
+  if (ns == R_NilValue) return -1;
+  R_xlen_t n = XLENGTH(ns);
+  for (R_xlen_t i = 0; i < n; ++i)
+    if (same(STRING_ELT(ns, i), name)) return i;
+  return -1;
+}
+
+SEXP State::symbol(const std::string &name)
+{
+  return Rf_mkCharCE(name.c_str(), CE_UTF8);
+}
+
 bool State::match(const Rcpp::List &rule) const
 {
   SEXP rule_ns = rule.names();
@@ -88,13 +114,12 @@ bool State::match(const Rcpp::List &rule) const
     }
     return false;
   }
-  CharacterVector ns(rule_ns);
-  for (auto n : ns) {
-    std::string name = as<std::string>(n);
-    if (!containsElementNamed(name.c_str())) return false;
-    auto x = (*this)[name];
-    SEXP y = rule[name];
-    if (!comp(x, y)) return false;
+  R_xlen_t n = rule.size();
+  for (R_xlen_t i = 0; i < n; ++i) {
+    R_xlen_t position = find(STRING_ELT(rule_ns, i));
+    if (position < 0) return false;
+    if (!comp(VECTOR_ELT(*this, position), VECTOR_ELT(rule, i)))
+      return false;
   }
   return true;
 }
@@ -125,16 +150,346 @@ State &State::operator&=(const List &y)
         }
       }
     } else {
-      CharacterVector ns = y.names();
-      for (auto n : ns) {
-        std::string name = as<std::string>(n);
-        (*this)[name] = y[name];
+      // the existing domains are set in place, and the new ones are
+      // appended at once
+      R_xlen_t n = y.size();
+      std::vector<R_xlen_t> added;
+      for (R_xlen_t i = 0; i < n; ++i) {
+        SEXP name = STRING_ELT(y_ns, i);
+        R_xlen_t position = find(name);
+        if (position >= 0)
+          SET_VECTOR_ELT(*this, position, VECTOR_ELT(y, i));
+        else {
+          bool duplicated = false;
+          for (auto j : added)
+            if (same(STRING_ELT(y_ns, j), name)) duplicated = true;
+          if (!duplicated) added.push_back(i);
+        }
+      }
+      if (!added.empty()) append(y, added);
+    }
+  }
+  return *this;
+}
+
+void State::append(const List &y, const std::vector<R_xlen_t> &domains)
+{
+  R_xlen_t n = size(), k = domains.size();
+  SEXP y_ns = y.names();
+  SEXP my_ns = names();
+  List values(n + k);
+  CharacterVector ns(n + k);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SET_VECTOR_ELT(values, i, VECTOR_ELT(*this, i));
+    SET_STRING_ELT(ns, i,
+                   my_ns == R_NilValue ? R_BlankString : STRING_ELT(my_ns, i));
+  }
+  for (R_xlen_t i = 0; i < k; ++i) {
+    // the value of the last domain with the name, as assigning the domains
+    // one by one would leave
+    SEXP name = STRING_ELT(y_ns, domains[i]);
+    SEXP value = VECTOR_ELT(y, domains[i]);
+    for (R_xlen_t j = domains[i] + 1; j < y.size(); ++j)
+      if (same(STRING_ELT(y_ns, j), name)) value = VECTOR_ELT(y, j);
+    SET_VECTOR_ELT(values, n + i, value);
+    SET_STRING_ELT(ns, n + i, name);
+  }
+  values.attr("names") = ns;
+  set__(values);
+}
+
+/**
+ * The hash of a value of a domain. Equal scalars have equal hashes, except
+ * strings in different encodings, which are then not shared.
+ */
+static size_t hashValue(SEXP x)
+{
+  size_t type = TYPEOF(x);
+  R_xlen_t n = Rf_xlength(x);
+  if (n != 1 || ATTRIB(x) != R_NilValue)
+    return type * 31 + n;
+  switch (type) {
+  case STRSXP:
+    return std::hash<SEXP>()(STRING_ELT(x, 0));
+  case REALSXP: {
+    double v = REAL(x)[0];
+    // 0 and -0 are identical
+    if (v == 0) return type;
+    if (std::isnan(v)) return type + (R_IsNA(v) ? 1 : 2);
+    return std::hash<double>()(v);
+  }
+  case INTSXP:
+    return std::hash<int>()(INTEGER(x)[0]);
+  case LGLSXP:
+    return std::hash<int>()(LOGICAL(x)[0]);
+  default:
+    return type;
+  }
+}
+
+/**
+ * Whether two values are identical, comparing scalars without calling
+ * identical()
+ */
+static bool equal(SEXP x, SEXP y)
+{
+  if (x == y) return true;
+  if (TYPEOF(x) != TYPEOF(y)) return false;
+  if (Rf_xlength(x) == 1 && Rf_xlength(y) == 1 &&
+      ATTRIB(x) == R_NilValue && ATTRIB(y) == R_NilValue) {
+    switch (TYPEOF(x)) {
+    case STRSXP:
+      // different objects may be the same string in different encodings
+      if (STRING_ELT(x, 0) == STRING_ELT(y, 0)) return true;
+      break;
+    case REALSXP: {
+      double a = REAL(x)[0], b = REAL(y)[0];
+      if (!std::isnan(a) && !std::isnan(b)) return a == b;
+      break;
+    }
+    case INTSXP:
+      return INTEGER(x)[0] == INTEGER(y)[0];
+    case LGLSXP:
+      return LOGICAL(x)[0] == LOGICAL(y)[0];
+    }
+  }
+  return R_compute_identical(x, y, 16);
+}
+
+static size_t combine(size_t seed, size_t hash)
+{
+  return seed ^ (hash + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+/** the value of a domain of a state after the changes */
+template <class Changes>
+static SEXP value(const State &state, const Changes &changes, R_xlen_t i)
+{
+  for (const auto &c : changes)
+    if (c.first == i) return c.second;
+  return VECTOR_ELT(state, i);
+}
+
+/** the hash of a state after the changes */
+template <class Changes>
+static size_t hashState(const State &state, const Changes &changes)
+{
+  SEXP ns = Rf_getAttrib(state, R_NamesSymbol);
+  R_xlen_t n = state.size();
+  size_t hash = n;
+  for (R_xlen_t i = 0; i < n; ++i) {
+    if (ns != R_NilValue)
+      hash = combine(hash, std::hash<SEXP>()(STRING_ELT(ns, i)));
+    hash = combine(hash, hashValue(value(state, changes, i)));
+  }
+  return hash;
+}
+
+SharedState::SharedState()
+  : _entry(empty())
+{
+  retain(_entry);
+}
+
+SharedState::SharedState(const State &state)
+  : _entry(intern(state, true))
+{
+}
+
+SharedState::SharedState(const SharedState &other)
+  : _entry(other._entry)
+{
+  retain(_entry);
+}
+
+SharedState::~SharedState()
+{
+  release(_entry);
+}
+
+SharedState &SharedState::operator=(const SharedState &other)
+{
+  retain(other._entry);
+  release(_entry);
+  _entry = other._entry;
+  return *this;
+}
+
+SharedState &SharedState::operator=(const State &state)
+{
+  Entry *entry = intern(state, true);
+  release(_entry);
+  _entry = entry;
+  return *this;
+}
+
+SharedState &SharedState::operator&=(const List &state)
+{
+  if (state.size() == 0) return *this;
+  const State &from = _entry->state;
+  // the positions of the changed domains, or none if the state changes
+  // its domains, which is left to State::operator&=()
+  Changes changes;
+  bool found = true;
+  SEXP y_ns = state.names();
+  if (y_ns == R_NilValue) {
+    SEXP my_ns = from.names();
+    R_xlen_t position = -1;
+    if (my_ns != R_NilValue) {
+      for (R_xlen_t i = 0; i < XLENGTH(my_ns) && position < 0; ++i)
+        if (STRING_ELT(my_ns, i) == R_BlankString) position = i;
+      // a state without a default domain is not changed
+      if (position < 0) return *this;
+    } else if (from.size() > 0) position = 0;
+    if (position < 0) found = false;
+    else changes.emplace_back(position, VECTOR_ELT(state, 0));
+  } else {
+    R_xlen_t n = state.size();
+    for (R_xlen_t i = 0; i < n && found; ++i) {
+      R_xlen_t position = from.find(STRING_ELT(y_ns, i));
+      if (position < 0) {
+        found = false;
+        break;
       }
+      bool replaced = false;
+      for (auto &c : changes)
+        if (c.first == position) {
+          c.second = VECTOR_ELT(state, i);
+          replaced = true;
+        }
+      if (!replaced) changes.emplace_back(position, VECTOR_ELT(state, i));
     }
   }
+  Entry *entry;
+  if (found) {
+    bool changed = false;
+    for (const auto &c : changes)
+      if (!equal(VECTOR_ELT(from, c.first), c.second)) changed = true;
+    if (!changed) return *this;
+    size_t hash = hashState(from, changes);
+    entry = lookup(hash, from, changes);
+    if (entry == nullptr) {
+      bool shared = repeated(hash);
+      if (!shared && owned()) {
+        // a state that is not worth sharing is changed in place
+        for (const auto &c : changes)
+          SET_VECTOR_ELT(_entry->state, c.first, c.second);
+        _entry->hash = hash;
+        return *this;
+      }
+      State next(clone(from));
+      for (const auto &c : changes)
+        SET_VECTOR_ELT(next, c.first, c.second);
+      entry = insert(next, hash, shared);
+    }
+    retain(entry);
+  } else entry = intern(from & state, false);
+  release(_entry);
+  _entry = entry;
   return *this;
 }
 
+State &SharedState::own()
+{
+  if (!owned()) {
+    Entry *entry = new Entry{State(clone(_entry->state)), 0, 1, false};
+    release(_entry);
+    _entry = entry;
+  }
+  return _entry->state;
+}
+
+SharedState::Entry *SharedState::intern(const State &state, bool copy)
+{
+  Changes none;
+  size_t hash = hashState(state, none);
+  Entry *entry = lookup(hash, state, none);
+  if (entry == nullptr)
+    entry = insert(copy ? State(clone(state)) : state, hash, repeated(hash));
+  retain(entry);
+  return entry;
+}
+
+SharedState::Entry *SharedState::lookup(
+    size_t hash, const State &state, const Changes &changes)
+{
+  SEXP ns = Rf_getAttrib(state, R_NamesSymbol);
+  R_xlen_t n = state.size();
+  auto range = table().equal_range(hash);
+  for (auto i = range.first; i != range.second; ++i) {
+    const State &candidate = i->second->state;
+    if (candidate.size() != n) continue;
+    SEXP candidate_ns = Rf_getAttrib(candidate, R_NamesSymbol);
+    if ((ns == R_NilValue) != (candidate_ns == R_NilValue)) continue;
+    bool same = true;
+    for (R_xlen_t j = 0; j < n && same; ++j) {
+      if (ns != R_NilValue && ns != candidate_ns &&
+          !State::same(STRING_ELT(ns, j), STRING_ELT(candidate_ns, j)))
+        same = false;
+      else if (!equal(value(state, changes, j), VECTOR_ELT(candidate, j)))
+        same = false;
+    }
+    if (same) return i->second;
+  }
+  return nullptr;
+}
+
+SharedState::Entry *SharedState::insert(
+    const State &state, size_t hash, bool shared)
+{
+  Entry *entry = new Entry{state, hash, 0, shared};
+  if (shared) {
+    // R copies a shared state before modifying it
+    MARK_NOT_MUTABLE(entry->state);
+    table().emplace(hash, entry);
+  }
+  return entry;
+}
+
+bool SharedState::repeated(size_t hash)
+{
+  // the hashes of the recent new states, by their low bits, so that a state
+  // that is reached by another agent soon after the first is shared
+  static const size_t size = 4096;
+  static size_t *recent = new size_t[size]();
+  size_t &slot = recent[hash & (size - 1)];
+  if (slot == hash) return true;
+  slot = hash;
+  return false;
+}
+
+void SharedState::release(Entry *entry)
+{
+  if (--entry->owners > 0) return;
+  if (entry->shared) {
+    auto range = table().equal_range(entry->hash);
+    for (auto i = range.first; i != range.second; ++i)
+      if (i->second == entry) {
+        table().erase(i);
+        break;
+      }
+  }
+  delete entry;
+}
+
+std::unordered_multimap<size_t, SharedState::Entry*> &SharedState::table()
+{
+  // never destroyed, as the states cannot be released after R exits
+  static auto *table = new std::unordered_multimap<size_t, Entry*>();
+  return *table;
+}
+
+SharedState::Entry *SharedState::empty()
+{
+  static Entry *entry = [] {
+    State state;
+    Entry *e = insert(state, hashState(state, Changes()), true);
+    retain(e);
+    return e;
+  }();
+  return entry;
+}
+
 // [[Rcpp::export]]
 bool stateMatch(List state, SEXP rule)
 {
@@ -0,0 +1,228 @@
+#include "../inst/include/StateIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+using namespace Rcpp;
+
+/**
+ * The width of an encoded value: a type code followed by the value, or the
+ * address of the cached string
+ */
+static const size_t PAYLOAD = std::max(sizeof(double), sizeof(SEXP));
+static const size_t WIDTH = 1 + PAYLOAD;
+
+/**
+ * Append the encoding of a value to a key
+ *
+ * @return false if the value cannot be indexed, in which case a missing
+ * value is appended
+ */
+static bool encode(SEXP value, std::string &key)
+{
+  char code = 0;
+  char payload[PAYLOAD] = {0};
+  if (value != R_NilValue && Rf_xlength(value) == 1) {
+    switch (TYPEOF(value)) {
+    case STRSXP: {
+      // strings are cached by R, so that equal strings share an address
+      SEXP s = STRING_ELT(value, 0);
+      code = 'c';
+      std::memcpy(payload, &s, sizeof(SEXP));
+      break;
+    }
+    case INTSXP: {
+      double x = INTEGER(value)[0];
+      code = 'i';
+      std::memcpy(payload, &x, sizeof(double));
+      break;
+    }
+    case REALSXP: {
+      double x = REAL(value)[0];
+      if (x == 0) x = 0; // -0 and 0 are equal
+      code = 'r';
+      std::memcpy(payload, &x, sizeof(double));
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  key.push_back(code);
+  key.append(payload, PAYLOAD);
+  return code != 0;
+}
+
+StateIndex::StateIndex(const std::vector<std::string> &domains)
+  : _domains(domains)
+{
+  if (_domains.empty())
+    stop("a state index must have at least one domain");
+  for (const auto &d : _domains)
+    if (d.empty())
+      stop("the indexed domains must have names");
+  std::unordered_set<std::string> names(_domains.begin(), _domains.end());
+  if (names.size() != _domains.size())
+    stop("the indexed domains must be distinct");
+}
+
+bool StateIndex::covers(const List &rule) const
+{
+  SEXP names = rule.names();
+  if (names == R_NilValue || rule.size() == 0)
+    return false;
+  for (R_xlen_t i = 0; i < rule.size(); ++i) {
+    const char *name = CHAR(STRING_ELT(names, i));
+    if (std::find(_domains.begin(), _domains.end(), name) == _domains.end())
+      return false;
+  }
+  return true;
+}
+
+std::string StateIndex::key(const List &state) const
+{
+  std::string k;
+  k.reserve(_domains.size() * WIDTH);
+  SEXP names = state.names();
+  R_xlen_t n = names == R_NilValue ? 0 : state.size();
+  bool indexed = false;
+  for (const auto &d : _domains) {
+    SEXP value = R_NilValue;
+    for (R_xlen_t i = 0; i < n; ++i) {
+      if (d == CHAR(STRING_ELT(names, i))) {
+        value = VECTOR_ELT(state, i);
+        break;
+      }
+    }
+    if (encode(value, k)) indexed = true;
+  }
+  return indexed ? k : std::string();
+}
+
+std::string StateIndex::key(const List &rule, std::vector<size_t> &positions)
+  const
+{
+  if (!covers(rule))
+    stop("the rule must specify values of indexed state domains only");
+  SEXP names = rule.names();
+  std::string k;
+  positions.clear();
+  for (R_xlen_t i = 0; i < rule.size(); ++i) {
+    const char *name = CHAR(STRING_ELT(names, i));
+    positions.push_back(
+      std::find(_domains.begin(), _domains.end(), name) - _domains.begin());
+    if (!encode(VECTOR_ELT(rule, i), k))
+      stop("the values of a rule must be character or numeric scalars");
+  }
+  return k;
+}
+
+bool StateIndex::agrees(const std::string &key, const std::string &partial,
+                        const std::vector<size_t> &positions) const
+{
+  for (size_t i = 0; i < positions.size(); ++i)
+    if (key.compare(positions[i] * WIDTH, WIDTH, partial, i * WIDTH, WIDTH))
+      return false;
+  return true;
+}
+
+void StateIndex::update(Agent &agent)
+{
+  std::string k = key(agent.state());
+  auto entry = _entries.find(&agent);
+  if (entry != _entries.end()) {
+    if (entry->second.bucket->first == k)
+      return;
+    remove(agent);
+  }
+  if (k.empty()) return;
+  auto &bucket = *_buckets.emplace(k, Bucket()).first;
+  _entries[&agent] = Entry{&bucket, bucket.second.size()};
+  bucket.second.push_back(&agent);
+}
+
+void StateIndex::remove(Agent &agent)
+{
+  auto entry = _entries.find(&agent);
+  if (entry == _entries.end()) return;
+  auto *bucket = entry->second.bucket;
+  Bucket &agents = bucket->second;
+  size_t i = entry->second.position;
+  if (i + 1 < agents.size()) {
+    agents[i] = agents.back();
+    _entries[agents[i]].position = i;
+  }
+  agents.pop_back();
+  _entries.erase(entry);
+  if (agents.empty())
+    _buckets.erase(_buckets.find(bucket->first));
+}
+
+std::vector<const StateIndex::Bucket*> StateIndex::buckets(
+    const List &rule) const
+{
+  std::vector<size_t> positions;
+  std::string partial = key(rule, positions);
+  std::vector<const Bucket*> result;
+  if (positions.size() == _domains.size()) {
+    // the rule specifies all domains, so its key is the full key, except
+    // that the domains may be in a different order
+    std::string k(_domains.size() * WIDTH, 0);
+    for (size_t i = 0; i < positions.size(); ++i)
+      k.replace(positions[i] * WIDTH, WIDTH, partial, i * WIDTH, WIDTH);
+    auto bucket = _buckets.find(k);
+    if (bucket != _buckets.end())
+      result.push_back(&bucket->second);
+    return result;
+  }
+  for (const auto &bucket : _buckets)
+    if (agrees(bucket.first, partial, positions))
+      result.push_back(&bucket.second);
+  return result;
+}
+
+size_t StateIndex::count(const List &rule) const
+{
+  size_t n = 0;
+  for (auto bucket : buckets(rule))
+    n += bucket->size();
+  return n;
+}
+
+std::vector<Agent*> StateIndex::sample(const List &rule, size_t k)
+{
+  auto matched = buckets(rule);
+  // the cumulative sizes of the matching buckets
+  std::vector<size_t> ends;
+  ends.reserve(matched.size());
+  size_t n = 0;
+  for (auto bucket : matched) {
+    n += bucket->size();
+    ends.push_back(n);
+  }
+  auto at = [&](size_t i) {
+    size_t b = std::upper_bound(ends.begin(), ends.end(), i) - ends.begin();
+    return (*matched[b])[i - (b == 0 ? 0 : ends[b - 1])];
+  };
+  std::vector<Agent*> result;
+  if (k >= n) {
+    result.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+      result.push_back(at(i));
+    return result;
+  }
+  // Floyd's algorithm draws k distinct positions in O(k)
+  std::unordered_set<size_t> chosen;
+  chosen.reserve(k);
+  result.reserve(k);
+  for (size_t j = n - k; j < n; ++j) {
+    size_t t = static_cast<size_t>(_unif.get() * (j + 1));
+    if (t > j) t = j;
+    if (!chosen.insert(t).second) {
+      chosen.insert(j);
+      t = j;
+    }
+    result.push_back(at(t));
+  }
+  return result;
+}
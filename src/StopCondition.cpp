@@ -0,0 +1,134 @@
+#include "../inst/include/StopCondition.h"
+#include "../inst/include/Simulation.h"
+#include <cmath>
+#include <sstream>
+
+using namespace Rcpp;
+
+/**
+ * Describe a threshold that has been reached
+ */
+static std::string threshold(const std::string &name, double value,
+                             double below)
+{
+  std::ostringstream s;
+  s << name << (value <= below ? " <= " : " >= ") << value;
+  return s.str();
+}
+
+static void checkThresholds(double below, double above)
+{
+  if (std::isnan(below) || std::isnan(above))
+    stop("the thresholds must not be NA");
+  if (std::isinf(below) && below < 0 && std::isinf(above) && above > 0)
+    stop("at least one threshold must be finite");
+}
+
+StopCondition::~StopCondition()
+{
+}
+
+void StopCondition::start()
+{
+}
+
+LoggerStop::LoggerStop(PLogger logger, double below, double above)
+  : _logger(logger), _below(below), _above(above), _value(R_NaN)
+{
+  checkThresholds(below, above);
+}
+
+bool LoggerStop::met(Simulation &sim)
+{
+  _value = _logger->value();
+  return _value <= _below || _value >= _above;
+}
+
+std::string LoggerStop::reason() const
+{
+  return threshold(_logger->name(), _value, _below);
+}
+
+CountStop::CountStop(const List &rule, double below, double above)
+  : _rule(rule), _below(below), _above(above), _value(R_NaN)
+{
+  checkThresholds(below, above);
+}
+
+bool CountStop::met(Simulation &sim)
+{
+  _value = sim.count(_rule);
+  return _value <= _below || _value >= _above;
+}
+
+std::string CountStop::reason() const
+{
+  return threshold("count", _value, _below);
+}
+
+BudgetStop::BudgetStop(double seconds, double events)
+  : _seconds(seconds), _events(events), _checks(0), _out_of_time(false)
+{
+  if (!(seconds > 0) || !(events > 0))
+    stop("the budgets must be positive");
+}
+
+void BudgetStop::start()
+{
+  _checks = 0;
+  _out_of_time = false;
+  _start = std::chrono::steady_clock::now();
+}
+
+bool BudgetStop::met(Simulation &sim)
+{
+  if (sim.handledEvents() >= _events)
+    return true;
+  // reading the clock is cheap, but not free, so it is read periodically
+  if (!std::isinf(_seconds) && _checks++ % 256 == 0) {
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - _start;
+    _out_of_time = elapsed.count() >= _seconds;
+  }
+  return _out_of_time;
+}
+
+std::string BudgetStop::reason() const
+{
+  return _out_of_time ? "time budget" : "event budget";
+}
+
+// [[Rcpp::export]]
+void addLoggerStop(XP<Simulation> sim, std::string logger,
+                   double below = R_NegInf, double above = R_PosInf)
+{
+  PLogger l = sim->logger(logger);
+  if (!l)
+    stop("logger not found: " + logger);
+  sim->addStopCondition(
+    std::unique_ptr<StopCondition>(new LoggerStop(l, below, above)));
+}
+
+// [[Rcpp::export]]
+void addCountStop(XP<Simulation> sim, List rule,
+                  double below = R_NegInf, double above = R_PosInf)
+{
+  // make sure that the rule is covered by an index
+  sim->count(rule);
+  sim->addStopCondition(
+    std::unique_ptr<StopCondition>(new CountStop(rule, below, above)));
+}
+
+// [[Rcpp::export]]
+void addBudgetStop(XP<Simulation> sim, double seconds = R_PosInf,
+                   double events = R_PosInf)
+{
+  sim->addStopCondition(
+    std::unique_ptr<StopCondition>(new BudgetStop(seconds, events)));
+}
+
+// [[Rcpp::export]]
+void clearStopConditions(XP<Simulation> sim)
+{
+  sim->clearStopConditions();
+}
@@ -40,9 +40,12 @@ Transition::~Transition() = default;
 
 bool TransitionEvent::handle(Simulation &sim, Agent &agent)
 {
+  Profile::record(Profile::TRANSITION_EVENT);
   double t = time();
   if (agent.match(_rule.from())) {
-    if (_rule.toChange(t, agent)) {
+    if (_rule.batched())
+      _rule.defer(sim, PEvent(this), agent);
+    else if (_rule.toChange(t, agent)) {
       PRINT("%lf, NA, %d, NA, 1\n", t, agent.id());
       agent.set(_rule.to());
       _rule.log(sim, *this, agent);
@@ -54,21 +57,42 @@ bool TransitionEvent::handle(Simulation &sim, Agent &agent)
 
 TransitionBase::TransitionBase(
     const List &from, const List &to,
-    Nullable<Function> to_change_callback,
-    Nullable<Function> changed_callback,
+    PCallback to_change_callback,
+    PCallback changed_callback,
     const std::vector<PEventLogger> &logging)
-  : _from(from), _to(to), _logging(logging)
+  : _from(from), _to(to), _to_change(to_change_callback),
+    _changed(changed_callback), _logging(logging),
+    _batch(dynamic_cast<BatchCallback*>(_to_change.get()))
 {
-  if (!to_change_callback.isNull())
-    _to_change.reset(new Function(to_change_callback));
-  if (!changed_callback.isNull())
-    _changed.reset(new Function(changed_callback));
+}
+
+TransitionBase::~TransitionBase() = default;
+
+void TransitionBase::defer(Simulation &sim, PEvent event, Agent &agent)
+{
+  if (_deferred.empty())
+    sim.schedule(makeOwned<BatchEvent>(
+        event->time() + _batch->window(), *this));
+  _deferred.push_back(
+    Deferred{std::move(event), PAgent(&agent), agent.membership()});
+}
+
+BatchEvent::BatchEvent(double time, TransitionBase &rule)
+  : Event(time), _rule(rule)
+{
+}
+
+bool BatchEvent::handle(Simulation &sim, Agent &agent)
+{
+  Profile::record(Profile::BATCH_EVENT);
+  _rule.flush(sim, time());
+  return false;
 }
 
 Transition::Transition(const List &from, const List &to,
                        PWaitingTime waiting_time,
-                       Nullable<Function> to_change_callback,
-                       Nullable<Function> changed_callback,
+                       PCallback to_change_callback,
+                       PCallback changed_callback,
                        const std::vector<PEventLogger> &logging)
   : TransitionBase(from, to, to_change_callback, changed_callback, logging),
     _waiting_time(waiting_time)
@@ -77,24 +101,49 @@ Transition::Transition(const List &from, const List &to,
 
 bool Transition::toChange(double time, Agent &agent)
 {
-  if (_to_change == nullptr) return true;
-  PXPLease lease = std::make_shared<XPLease>();
-  return as<bool>((*_to_change)(
-    NumericVector::create(time), XP<Agent>(agent, lease)));
+  return _to_change == nullptr || _to_change->toChange(time, agent, nullptr);
 }
 
 void Transition::changed(double time, Agent &agent)
 {
-  if (_changed != nullptr) {
-    PXPLease lease = std::make_shared<XPLease>();
-    (*_changed)(NumericVector::create(time), XP<Agent>(agent, lease));
-  }
+  if (_changed != nullptr)
+    _changed->changed(time, agent, nullptr);
 }
 
-void Transition::log(Simulation &simulation, TransitionEvent &event, Agent &agent)
+void Transition::log(
+    Simulation &simulation, TransitionEvent &event, Agent &agent,
+    double count)
 {
   for (auto &logger : _logging)
-    logger->log(simulation, agent, event);
+    logger->log(simulation, agent, event, count);
+}
+
+void Transition::flush(Simulation &sim, double t)
+{
+  std::vector<Deferred> deferred;
+  deferred.swap(_deferred);
+  std::vector<Deferred*> pending;
+  std::vector<double> times;
+  std::vector<Agent*> agents;
+  for (auto &d : deferred) {
+    if (d.agent->membership() != d.membership || !d.agent->match(_from))
+      continue;
+    pending.push_back(&d);
+    times.push_back(d.event->time());
+    agents.push_back(d.agent.get());
+  }
+  if (pending.empty()) return;
+  std::vector<bool> change = _batch->evaluate(times, agents, {});
+  for (size_t i = 0; i < pending.size(); ++i) {
+    Agent &agent = *pending[i]->agent;
+    if (!change[i] || agent.membership() != pending[i]->membership ||
+        !agent.match(_from))
+      continue;
+    PRINT("%lf, NA, %d, NA, 1\n", t, agent.id());
+    agent.set(_to);
+    log(sim, static_cast<TransitionEvent&>(*pending[i]->event), agent);
+    changed(t, agent);
+  }
 }
 
 void Transition::schedule(double time, Agent &agent)
@@ -108,27 +157,92 @@ void Transition::schedule(double time, Agent &agent)
 ContactEvent::ContactEvent(double time, Agent &contact, Contact &source,
                            ContactTransition &rule)
   : Event(time), _rule(rule), _source(source), _contact(&contact),
-    _contact_lease(contact.membershipLease())
+    _membership(contact.membership()), _agent(nullptr),
+    _dependency(NONE)
+{
+}
+
+ContactEvent::~ContactEvent()
+{
+  detach();
+}
+
+void ContactEvent::attach(Agent &agent)
+{
+  _agent = &agent;
+  if (_dependency != NONE) return;
+  _dependency = _contact->_dependents.size();
+  _contact->_dependents.push_back(this);
+}
+
+void ContactEvent::detach()
+{
+  if (_dependency == NONE) return;
+  auto &dependents = _contact->_dependents;
+  dependents[_dependency] = dependents.back();
+  dependents[_dependency]->_dependency = _dependency;
+  dependents.pop_back();
+  _dependency = NONE;
+}
+
+void ContactEvent::orphan()
+{
+  detach();
+  _contact = nullptr;
+}
+
+void ContactEvent::cancel()
 {
+  if (_owner == nullptr || _agent == nullptr) return;
+  Profile::record(Profile::STALE_CONTACT);
+  PEvent self(this);
+  Agent &agent = *_agent;
+  detach();
+  _owner->unschedule(self);
+  agent.releaseContactEvents();
+}
+
+bool ContactEvent::current(const Agent &agent) const
+{
+  if (_contact == nullptr || _contact->membership() != _membership)
+    return false;
+  const Population *owner = agent.population();
+  return owner != nullptr && owner == _contact->population() &&
+    owner == _source.population();
 }
 
 bool ContactEvent::handle(Simulation &sim, Agent &agent)
 {
+  Profile::record(Profile::CONTACT_EVENT);
+  detach();
   double t = time();
-  if (_contact_lease.expired())
+  if (_contact == nullptr || _contact->membership() != _membership)
     return false;
   Population *owner = agent.population();
-  if (owner == nullptr || owner != _contact->population() ||
-      owner != _source.population()) {
+  if (!current(agent)) {
     PRINT("%lf, NA, %ld, %ld, 0\n", t, agent.id(), _contact->id());
     return false;
   }
   if (agent.match(_rule.from())) {
+    if (_rule.batched()) {
+      // stay attached, so that the event is discarded if the contact is
+      // destroyed before the end of the window
+      if (_contact->match(_rule.contactFrom())) {
+        attach(agent);
+        _rule.defer(sim, PEvent(this), agent);
+      }
+      _rule.schedule(t, agent, _source);
+      return false;
+    }
     bool left_from = false;
+    // the callback may remove the contact, which is kept alive until its
+    // membership is checked
+    PAgent contact(_contact);
     bool contact_matches = _contact->match(_rule.contactFrom());
     bool change = contact_matches && _rule.toChange(t, agent, *_contact);
     if (contact_matches) {
-      if (_contact_lease.expired() || agent.population() != owner ||
+      if (_contact->membership() != _membership ||
+          agent.population() != owner ||
           _source.population() != owner)
         return false;
       if (_contact->population() != owner)
@@ -156,8 +270,8 @@ ContactTransition::ContactTransition(
   const Rcpp::List &agent_to, const Rcpp::List &contact_to,
   std::optional<std::string> contact_type,
   PWaitingTime waiting_time, 
-  Rcpp::Nullable<Rcpp::Function> to_change_callback, 
-  Rcpp::Nullable<Rcpp::Function> changed_callback,
+  PCallback to_change_callback, 
+  PCallback changed_callback,
   const std::vector<PEventLogger> &logging)
   : TransitionBase(agent_from, agent_to, to_change_callback,
                    changed_callback, logging),
@@ -168,30 +282,21 @@ ContactTransition::ContactTransition(
 
 bool ContactTransition::toChange(double time, Agent &agent, Agent &contact)
 {
-  if (_to_change == nullptr) return true;
-  PXPLease lease = std::make_shared<XPLease>();
-  return as<bool>((*_to_change)(
-    NumericVector::create(time),
-    XP<Agent>(agent, lease),
-    XP<Agent>(contact, lease)));
+  return _to_change == nullptr || _to_change->toChange(time, agent, &contact);
 }
 
 void ContactTransition::changed(double time, Agent &agent, Agent &contact)
 {
-  if (_changed != nullptr) {
-    PXPLease lease = std::make_shared<XPLease>();
-    (*_changed)(
-      NumericVector::create(time),
-      XP<Agent>(agent, lease),
-      XP<Agent>(contact, lease));
-  }
+  if (_changed != nullptr)
+    _changed->changed(time, agent, &contact);
 }
 
 void ContactTransition::log(
-    Simulation &simulation, ContactEvent &event, Agent &agent)
+    Simulation &simulation, ContactEvent &event, Agent &agent,
+    double count)
 {
   for (auto &logger : _logging)
-    logger->log(simulation, agent, event);
+    logger->log(simulation, agent, event, count);
 }
 
 bool ContactTransition::matches(const Contact &contact) const
@@ -199,6 +304,43 @@ bool ContactTransition::matches(const Contact &contact) const
   return !_contact_type || contact.type() == *_contact_type;
 }
 
+void ContactTransition::flush(Simulation &sim, double t)
+{
+  std::vector<Deferred> deferred;
+  deferred.swap(_deferred);
+  std::vector<Deferred*> pending;
+  std::vector<double> times;
+  std::vector<Agent*> agents, contacts;
+  for (auto &d : deferred) {
+    auto &event = static_cast<ContactEvent&>(*d.event);
+    if (d.agent->membership() != d.membership || !event.current(*d.agent) ||
+        !d.agent->match(_from) || !event.contact().match(_contact_from))
+      continue;
+    pending.push_back(&d);
+    times.push_back(event.time());
+    agents.push_back(d.agent.get());
+    contacts.push_back(&event.contact());
+  }
+  if (pending.empty()) return;
+  std::vector<bool> change = _batch->evaluate(times, agents, contacts);
+  for (size_t i = 0; i < pending.size(); ++i) {
+    Agent &agent = *pending[i]->agent;
+    auto &event = static_cast<ContactEvent&>(*pending[i]->event);
+    if (!change[i] || agent.membership() != pending[i]->membership ||
+        !event.current(agent) || !agent.match(_from) ||
+        !event.contact().match(_contact_from))
+      continue;
+    Agent &contact = event.contact();
+    PRINT("%lf, NA, %ld, %ld, 1\n", t, agent.id(), contact.id());
+    if (!agent.match(_to))
+      agent.set(_to);
+    if (!contact.match(_contact_to))
+      contact.set(_contact_to);
+    log(sim, event, agent);
+    changed(t, agent, contact);
+  }
+}
+
 void ContactTransition::schedule(
     double time, Agent &agent, Contact &source)
 {
@@ -220,13 +362,15 @@ void ContactTransition::schedule(
     Agent *managed = source.population()->agent(*next_contact);
     if (!managed)
       stop("contact returned an agent not managed by its population");
-    agent._contactEvents->schedule(makeOwned<ContactEvent>(
-        waiting_time + time, *managed, source, *this));
+    auto event = makeOwned<ContactEvent>(
+        waiting_time + time, *managed, source, *this);
+    event->attach(agent);
+    agent.contactEvents().schedule(event);
   }
 }
 
 ExpWaitingTime::ExpWaitingTime(double rate)
-  : _exp(rate)
+  : _exp(rate), _rate(rate)
 {
 }
 
@@ -252,6 +396,7 @@ RWaitingTime::RWaitingTime(Function f)
 
 double RWaitingTime::waitingTime(double time)
 {
+  Profile::Timer timer(Profile::R_CALLBACK);
   return as<double>(_f(NumericVector::create(time)));
 }
 